@@ -9,12 +9,6 @@
 
 int main(int argc, char *argv[])
 {
-    if (!glfwInit())
-    {
-        assert(false && "Failed to initialized GLFW Library");
-    }
-    GLFWwindow *w = initGLFWContext();
-
     cxxopts::Options options("AnRoll CMD", "Model Parameters");
 
     options.add_options()("m,mask", "Input Mask Path", cxxopts::value<std::string>()->default_value("test.png"));
@@ -31,6 +25,15 @@ int main(int argc, char *argv[])
     options.add_options()("y,grid-y", "Grid Lines Vertical", cxxopts::value<int>()->default_value("21"));
     options.add_options()("t,grid-t", "Grid Line Thickness", cxxopts::value<int>()->default_value("1"));
     options.add_options()("image-active", "Image Active", cxxopts::value<bool>()->default_value("true"));
+    options.add_options()("cpu-render", "Software Rasterizer instead of OpenGL", cxxopts::value<bool>()->default_value("false"));
+    options.add_options()("cpu-map", "CPU Image Mapping instead of the Compute Shader", cxxopts::value<bool>()->default_value("false"));
+    options.add_options()("warp", "Backward Warp of the Image instead of a Mesh", cxxopts::value<bool>()->default_value("false"));
+    options.add_options()("textured", "Coarse Textured Mesh instead of a Vertex per Pixel", cxxopts::value<bool>()->default_value("false"));
+    options.add_options()("mesh-step", "Image Pixels per Cell of the Textured Mesh", cxxopts::value<int>()->default_value("8"));
+    options.add_options()("adaptive", "Textured Mesh Refined where the Mapping Bends", cxxopts::value<bool>()->default_value("false"));
+    options.add_options()("tolerance", "Max. Deviation of the Adaptive Mesh in Pixels", cxxopts::value<float>()->default_value("0.5"));
+    options.add_options()("export-size", "Band-Streamed Export of the Image at this Size, without Grid (0 = off)", cxxopts::value<int>()->default_value("0"));
+    options.add_options()("stage-stats", "Print the Hits and Misses of the Pipeline Stages", cxxopts::value<bool>()->default_value("false"));
     options.add_options()("h,help", "Print usage");
 
     auto result = options.parse(argc, argv);
@@ -49,6 +52,15 @@ int main(int argc, char *argv[])
     int grid_lines_h = result["grid-x"].as<int>();
     int grid_lines_v = result["grid-y"].as<int>();
     int grid_thickness = result["grid-t"].as<int>();
+    bool cpu_render = result["cpu-render"].as<bool>();
+    bool cpu_map = result["cpu-map"].as<bool>();
+    bool warp = result["warp"].as<bool>();
+    bool textured = result["textured"].as<bool>();
+    int mesh_step = result["mesh-step"].as<int>();
+    bool adaptive = result["adaptive"].as<bool>();
+    float tolerance = result["tolerance"].as<float>();
+    int export_size = result["export-size"].as<int>();
+    bool stage_stats = result["stage-stats"].as<bool>();
 
     if (result.count("help"))
     {
@@ -86,10 +98,44 @@ int main(int argc, char *argv[])
     model->getModelPublicProperties()._grid_y.setValue({grid_lines_v, true});
     model->getModelPublicProperties()._image_active.setValue({image_active, true});
     model->getModelPublicProperties()._grid_thickness.setValue({grid_thickness, true});
+    model->getModelPublicProperties()._render_use_cpu.setValue({cpu_render, true});
+    model->getModelPublicProperties()._map_use_cpu.setValue({cpu_map, true});
+    model->getModelPublicProperties()._render_warp.setValue({warp, true});
+    model->getModelPublicProperties()._render_textured.setValue({textured, true});
+    model->getModelPublicProperties()._texture_mesh_step.setValue({mesh_step, true});
+    model->getModelPublicProperties()._render_adaptive.setValue({adaptive, true});
+    model->getModelPublicProperties()._adaptive_tolerance.setValue({tolerance, true});
+
+    // the CPU backends run without a GL context
+    GLFWwindow *w = nullptr;
+    if (model->usesGPU())
+    {
+        if (glfwInit())
+        {
+            w = initGLFWContext();
+        }
+        if (w == nullptr)
+        {
+            std::cerr << "No OpenGL context, use --cpu-render with --cpu-map or --warp\n";
+            delete model;
+            stbi_image_free(img);
+            stbi_image_free(mask_raw);
+            return 1;
+        }
+    }
 
     model->updateState();
 
     RenderResult r;
+    if (image_active && export_size > 0)
+    {
+        // large outputs never exist as a whole in memory
+        if (!model->exportImage(output_file, export_size))
+        {
+            std::cerr << "Failed to export " << output_file << "\n";
+        }
+        image_active = grid_active = false;
+    }
     if (image_active)
     {
         r = model->renderImage();
@@ -103,6 +149,10 @@ int main(int argc, char *argv[])
     {
         stbi_write_png(output_file.c_str(), r.width, r.height, CHANNELS, r.image, 0);
     }
+    if (stage_stats)
+    {
+        std::cout << model->getStageStatistics();
+    }
 
     delete model;
     stbi_image_free(img);
@@ -0,0 +1,150 @@
+#include "cpu_error_kernel.hpp"
+
+#include "simd.hpp"
+
+//********************************/
+// Vectorized error kernel implementation
+//
+// Mirrors ErrorMapper::runRows with float lanes. Compared to the double precision path the
+// per-pixel errors differ by the float rounding of the mapped points (relative ~1e-4 for the
+// jittered distances) plus the sin/cos/acos approximation errors documented in simd.hpp.
+
+#if defined(ANROLL_HAS_VECTOR_EXTENSIONS)
+
+static const float KERNEL_PI = 3.14159265358979f;
+
+// vectorized getErrorColor
+static inline void errorColor(vfloat8 t, vfloat8 &r, vfloat8 &g, vfloat8 &b)
+{
+    static const float C[5][3] = {{0.0f, 0.114f, 0.549f}, {0.161f, 0.3333f, 1.0f}, {1.0f, 1.0f, 1.0f}, {1.0f, 0.157f, 0.2f}, {0.557f, 0.0f, 0.016f}};
+
+    t = vclamp(t - 0.5f, 0.f, 1.f);
+
+    vint8 s0 = t < 0.45f;
+    vint8 s1 = t < 0.5f;
+    vint8 s2 = t <= 0.55f;
+
+    vfloat8 u = vselect(s0, t / 0.45f, vselect(s1, (t - 0.45f) / 0.05f, vselect(s2, (t - 0.5f) / 0.05f, (t - 0.55f) / 0.45f)));
+
+    vfloat8 *channels[3] = {&r, &g, &b};
+    for (int ch = 0; ch < 3; ch++)
+    {
+        vfloat8 lo = vselect(s0, vset(C[0][ch]), vselect(s1, vset(C[1][ch]), vselect(s2, vset(C[2][ch]), vset(C[3][ch]))));
+        vfloat8 hi = vselect(s0, vset(C[1][ch]), vselect(s1, vset(C[2][ch]), vselect(s2, vset(C[3][ch]), vset(C[4][ch]))));
+        *channels[ch] = lo * (1.f - u) + hi * u;
+    }
+}
+
+static inline vfloat8 squaredError(vfloat8 error)
+{
+    vfloat8 e = vclamp(error - 1.f, -1.f, 1.f);
+    return e * e;
+}
+
+static inline void storeColor(float *dst, int index, int lanes, vfloat8 r, vfloat8 g, vfloat8 b)
+{
+    for (int l = 0; l < lanes; l++)
+    {
+        dst[(index + l) * 3] = r[l];
+        dst[(index + l) * 3 + 1] = g[l];
+        dst[(index + l) * 3 + 2] = b[l];
+    }
+}
+
+static inline void storeError(double *dst, int index, int lanes, vfloat8 e)
+{
+    for (int l = 0; l < lanes; l++)
+    {
+        dst[index + l] = e[l];
+    }
+}
+
+bool errorKernelVectorAvailable()
+{
+#if defined(__AVX2__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return true;
+#endif
+}
+
+void errorKernelVectorRow(const ErrorKernelParams &params, const ErrorKernelRow &row, const ErrorKernelOutput &out, int yi)
+{
+    const int width = params.width;
+    const float step = 1.f / (float(width) - 1);
+
+    for (int xi0 = 0; xi0 < width; xi0 += SIMD_LANES)
+    {
+        int lanes = width - xi0 < SIMD_LANES ? width - xi0 : SIMD_LANES;
+
+        vfloat8 xi, area_center, area_jitter;
+        for (int l = 0; l < SIMD_LANES; l++)
+        {
+            int column = l < lanes ? xi0 + l : width - 1;
+            xi[l] = float(column);
+            area_center[l] = params.if_center[column];
+            area_jitter[l] = params.if_jitter[column];
+        }
+
+        vfloat8 t = xi * step;
+        vfloat8 x = params.crop_left * (1.f - t) + (1.f - params.crop_right) * t;
+        x = (x - 0.5f) * 2.f;
+        vfloat8 x_jitter = x + vselect(x <= 0.f, vset(params.jitter), vset(-params.jitter));
+
+        vfloat8 cx, cy, rx, ry, bx, by;
+        circlePoint(row.r_center, row.cp_center, params.tilt, arcOffset(x, area_center, row.r_orig_center, row.r_fit_center), cx, cy);
+        circlePoint(row.r_center, row.cp_center, params.tilt, arcOffset(x_jitter, area_jitter, row.r_orig_center, row.r_fit_center), rx, ry);
+        circlePoint(row.r_bottom, row.cp_bottom, params.tilt, arcOffset(x, area_center, row.r_orig_bottom, row.r_fit_bottom), bx, by);
+
+        vfloat8 right_x = rx - cx, right_y = ry - cy;
+        vfloat8 up_x = bx - cx, up_y = by - cy;
+        vfloat8 distance_x = vsqrt(right_x * right_x + right_y * right_y);
+        vfloat8 distance_y = vsqrt(up_x * up_x + up_y * up_y);
+
+        vfloat8 x_error = ((distance_x * 2.f) / params.jitter) / row.circ_orig;
+        vfloat8 y_error = (distance_y / params.jitter) / params.a;
+        vfloat8 r_error = x_error / y_error;
+
+        // angle between point_center->point_right and point_center->point_bottom (zero vectors normalize to zero)
+        vfloat8 lengths = distance_x * distance_y;
+        vfloat8 cos_angle = vselect(lengths > 0.f, (up_x * right_x + up_y * right_y) / lengths, vset(0.f));
+        vfloat8 angle = vacos(cos_angle);
+        vfloat8 angle_error = 1.f + (angle - KERNEL_PI / 2) / (KERNEL_PI / 2);
+
+        int index = yi * width + xi0;
+        for (int l = 0; l < lanes; l++)
+        {
+            out.x[index + l] = cx[l];
+            out.y[index + l] = cy[l];
+        }
+
+        storeError(out.e_x, index, lanes, squaredError(x_error));
+        storeError(out.e_y, index, lanes, squaredError(y_error));
+        storeError(out.e_r, index, lanes, squaredError(r_error));
+        storeError(out.e_a, index, lanes, squaredError(angle_error));
+
+        vfloat8 xr, xg, xb, yr, yg, yb, r, g, b;
+        errorColor(x_error, xr, xg, xb);
+        errorColor(y_error, yr, yg, yb);
+        storeColor(out.c_x, index, lanes, xr, xg, xb);
+        storeColor(out.c_y, index, lanes, yr, yg, yb);
+        storeColor(out.c_xy, index, lanes, (xr + yr) * 0.5f, (xg + yg) * 0.5f, (xb + yb) * 0.5f);
+        errorColor(r_error, r, g, b);
+        storeColor(out.c_r, index, lanes, r, g, b);
+        errorColor(angle_error, r, g, b);
+        storeColor(out.c_a, index, lanes, r, g, b);
+    }
+}
+
+#else
+
+bool errorKernelVectorAvailable()
+{
+    return false;
+}
+
+void errorKernelVectorRow(const ErrorKernelParams &, const ErrorKernelRow &, const ErrorKernelOutput &, int)
+{
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+//********************************/
+// Vectorized error kernel
+//
+// Processes one row of the error map 8 pixels at a time in single precision (structure of arrays).
+// The interface only uses plain data, so cpu_error_kernel.cpp can be compiled for AVX2 without
+// sharing any inline code with the rest of the program.
+// ErrorMapper::runRows (scalar, double precision) stays the reference implementation.
+
+// max. difference of a squared error (_e_*) to the reference: the float points are differenced over
+// JITTER, which scales their rounding (~4e-6) up to a few 1e-3 (checked by tests/test_error_kernel.cpp)
+#define ERROR_KERNEL_MAX_DEVIATION 5e-3
+
+// per row constants, computed in double precision by the caller
+struct ErrorKernelRow
+{
+    float r_center, r_bottom;   // semicircle radius of the pixel row and of the jittered row below
+    float cp_center, cp_bottom; // y of the semicircle center point
+    float r_orig_center, r_fit_center;
+    float r_orig_bottom, r_fit_bottom;
+    float circ_orig; // circumference of the contour at the pixel row
+};
+
+struct ErrorKernelParams
+{
+    int width;
+    float a, tilt, crop_left, crop_right, jitter;
+    const float *if_center; // IF curve integrals of the pixel columns
+    const float *if_jitter; // IF curve integrals of the jittered columns
+};
+
+struct ErrorKernelOutput
+{
+    float *x, *y;
+    double *e_x, *e_y, *e_r, *e_a;
+    float *c_x, *c_y, *c_xy, *c_r, *c_a;
+};
+
+// true if the kernel was built and the cpu supports the instruction set it was built for
+bool errorKernelVectorAvailable();
+
+void errorKernelVectorRow(const ErrorKernelParams &params, const ErrorKernelRow &row, const ErrorKernelOutput &out, int yi);
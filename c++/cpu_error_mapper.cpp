@@ -15,11 +15,6 @@ void ErrorMapper::setParams(int width, int height, double a, double IF, double r
 {
     assert(width != 0 && "Called setSize with invalid width");
 
-    if (_result != nullptr)
-    {
-        delete _result;
-    }
-
     _width = width;
     _height = height;
     _size = width * height;
@@ -31,24 +26,24 @@ void ErrorMapper::setParams(int width, int height, double a, double IF, double r
     _crop_left = crop_left;
     _crop_right = crop_right;
     _mapping_tables = mapping_tables;
-
-    _result = new CPUErrorMapResult(width, height);
 }
 
-Vec4 ErrorMapper::getCirclePoint(double r, Vec4 cp, double arc_offset)
+template <typename T>
+MappedPoint<T> ErrorMapper::getCirclePoint(T r, T cp_y, T arc_offset)
 {
-    double phi = arc_offset / r;
-    double x = r * sin(phi);
-    double y = cp.g - r * cos(phi);
+    T phi = arc_offset / r;
+    T x = r * sin(phi);
+    T y = cp_y - r * cos(phi);
 
     // apply artificial tilt (not really a perspective transformation)
-    double y_flat = cp.g - r;
+    T y_flat = cp_y - r;
     y = mix(y, y_flat, _tilt);
 
-    return Vec4(x, y);
+    return {x, y};
 }
 
-double ErrorMapper::getRadiusIF(int yi, double cIF)
+template <typename T>
+T ErrorMapper::getRadiusIF(int yi, T cIF)
 {
     float r_orig = _mapping_tables->_a_x_y[yi];
     float r_fit = _mapping_tables->_linear_fit[yi];
@@ -56,114 +51,385 @@ double ErrorMapper::getRadiusIF(int yi, double cIF)
     return (r_fit + (r_orig - r_fit) * cIF);
 }
 
-Vec4 ErrorMapper::mapPoint(double x, int xi, int yi)
+template <>
+void ErrorMapper::getParams<double>(double &IF, double &rad_factor)
 {
-    double h_a = double(_mapping_tables->_x_a_x[yi]);
-    double arc_offset = 0.0;
+    IF = _IF;
+    rad_factor = _rad_factor;
+}
+
+template <>
+void ErrorMapper::getParams<Dual>(Dual &IF, Dual &rad_factor)
+{
+    IF = _IF_gradient;
+    rad_factor = _rad_factor_gradient;
+}
+
+template <>
+double ErrorMapper::getIntegral<double>(int xi)
+{
+    return double(_mapping_tables->_if_curve_integrals[xi]);
+}
+
+template <>
+Dual ErrorMapper::getIntegral<Dual>(int xi)
+{
+    return _gradients->_if_curve_integrals[xi];
+}
+
+template <>
+double ErrorMapper::getHeight<double>(int yi)
+{
+    return double(_mapping_tables->_x_a_x[yi]);
+}
+
+template <>
+Dual ErrorMapper::getHeight<Dual>(int yi)
+{
+    return _gradients->_x_a_x[yi];
+}
+
+template <typename T>
+MappedPoint<T> ErrorMapper::mapPoint(double x, int xi, int yi)
+{
+    T IF, rad_factor;
+    getParams(IF, rad_factor);
+
+    T h_a = getHeight<T>(yi);
+    T arc_offset = 0.0;
 
     if (x != 0.0)
     {
-        double area = double(_mapping_tables->_if_curve_integrals[xi]);
-        double circ = getRadiusIF(yi, area / abs(x)) * M_PI * 2;
+        T area = getIntegral<T>(xi);
+        T circ = getRadiusIF(yi, area / abs(x)) * M_PI * 2;
         arc_offset = circ / 2 * x;
     }
 
-    double sc_rad_h = getRadiusIF(yi, _IF) * _rad_factor;
-    Vec4 sc_cp(0, _a - h_a + sc_rad_h);
+    T sc_rad_h = getRadiusIF(yi, IF) * rad_factor;
+    T sc_cp = _a - h_a + sc_rad_h;
 
     return getCirclePoint(sc_rad_h, sc_cp, arc_offset);
 }
 
+// mapPoint for the analytic tables plus the partial derivatives of the mapped point
+// d_dx: with respect to x in [-1, 1], d_dh: with respect to the arc-length height h_a
+void ErrorMapper::mapPointJacobian(double x, int xi, int yi, Vec4 &point, Vec4 &d_dx, Vec4 &d_dh)
+{
+    double h_a = double(_mapping_tables->_x_a_x[yi]);
+    double r_orig = double(_mapping_tables->_a_x_y[yi]);
+    double r_fit = double(_mapping_tables->_linear_fit[yi]);
+    double d_h_a = double(_mapping_tables->_d_x_a_x[yi]);
+    double d_r_orig = double(_mapping_tables->_d_a_x_y[yi]);
+    double d_r_fit = double(_mapping_tables->_d_linear_fit);
+
+    double area = double(_mapping_tables->_if_curve_integrals[xi]);
+    double if_value = double(_mapping_tables->_if_curve_values[xi]);
+    double sign_x = x < 0 ? -1.0 : 1.0;
+
+    // arc_offset = pi * x * getRadiusIF(yi, area / |x|), which is smooth in x (area(0) = 0)
+    double arc_offset = M_PI * (x * r_fit + (r_orig - r_fit) * area * sign_x);
+    double d_arc_offset_dx = M_PI * (r_fit + (r_orig - r_fit) * if_value);
+    double d_arc_offset_dh = M_PI * (x * d_r_fit + (d_r_orig - d_r_fit) * area * sign_x);
+
+    double sc_rad_h = (r_fit + (r_orig - r_fit) * _IF) * _rad_factor;
+    double d_sc_rad_h = (d_r_fit + (d_r_orig - d_r_fit) * _IF) * _rad_factor;
+    Vec4 sc_cp(0, _a - h_a + sc_rad_h);
+    double d_sc_cp = -d_h_a + d_sc_rad_h;
+
+    MappedPoint<double> circle_point = getCirclePoint(sc_rad_h, sc_cp.g, arc_offset);
+    point = Vec4(circle_point.x, circle_point.y);
+
+    double phi = arc_offset / sc_rad_h;
+    double d_phi_dh = (d_arc_offset_dh - phi * d_sc_rad_h) / sc_rad_h;
+    double sin_phi = sin(phi);
+    double cos_phi = cos(phi);
+
+    // y = cp - r * ((1 - tilt) * cos(phi) + tilt)
+    d_dx = Vec4(cos_phi, (1 - _tilt) * sin_phi) * d_arc_offset_dx;
+    d_dh = Vec4(d_sc_rad_h * sin_phi + sc_rad_h * cos_phi * d_phi_dh,
+                d_sc_cp - d_sc_rad_h * ((1 - _tilt) * cos_phi + _tilt) + sc_rad_h * (1 - _tilt) * sin_phi * d_phi_dh);
+}
+
+#define ROW_BANDS_PER_THREAD 4
 void ErrorMapper::map(int width, int height, MappingTables *mapping_tables, float arc_length, float interpolation_factor, float radius_modifier, float tilt, float crop_left, float crop_right)
 {
     setParams(width, height, double(arc_length), double(interpolation_factor), double(radius_modifier), mapping_tables, double(tilt), double(crop_left), double(crop_right));
+
+    // every entry is overwritten by run(), so the result is only reallocated if the size changes
+    if (_result == nullptr || _result->_width != width || _result->_height != height)
+    {
+        delete _result;
+        _result = new CPUErrorMapResult(width, height);
+    }
+
     run();
 }
 
+// evaluates the errors without writing _result (no points, colors or triangles)
+ErrorSums ErrorMapper::reduce(int width, int height, MappingTables *mapping_tables, float arc_length, float interpolation_factor, float radius_modifier, float tilt, float crop_left, float crop_right)
+{
+    setParams(width, height, double(arc_length), double(interpolation_factor), double(radius_modifier), mapping_tables, double(tilt), double(crop_left), double(crop_right));
+    return reduceAll(_row_sums);
+}
+
+// reduce() plus the derivatives of the sums with respect to the parameters carried by the Dual inputs
+// (interpolation factor, radius modifier and the parameter dependent table entries in gradients)
+// only available for ERROR_MODE_JITTER
+DualErrorSums ErrorMapper::reduceGradient(int width, int height, MappingTables *mapping_tables, const MappingTableGradients *gradients, float arc_length, Dual interpolation_factor, Dual radius_modifier, float tilt, float crop_left, float crop_right)
+{
+    assert(_mode == ERROR_MODE_JITTER && "Gradients require the jittered error mapping tables");
+
+    setParams(width, height, double(arc_length), interpolation_factor.v, radius_modifier.v, mapping_tables, double(tilt), double(crop_left), double(crop_right));
+    _IF_gradient = interpolation_factor;
+    _rad_factor_gradient = radius_modifier;
+    _gradients = gradients;
+    return reduceAll(_row_sums_gradient);
+}
+
+// the per row sums are added up in row order, so the result does not depend on the number of threads
+template <typename T>
+BasicErrorSums<T> ErrorMapper::reduceAll(std::vector<BasicErrorSums<T>> &row_sums)
+{
+    row_sums.resize(_height);
+    if (_parallel)
+    {
+        ThreadPool &pool = ThreadPool::shared();
+        pool.parallelFor(0, _height, pool.size() * ROW_BANDS_PER_THREAD, [this, &row_sums](int, int row_begin, int row_end)
+                         { reduceRows(row_begin, row_end, row_sums); });
+    }
+    else
+    {
+        reduceRows(0, _height, row_sums);
+    }
+
+    BasicErrorSums<T> sums;
+    for (const BasicErrorSums<T> &sums_of_row : row_sums)
+    {
+        sums.add(sums_of_row);
+    }
+    return sums;
+}
+
+template <typename T>
+void ErrorMapper::reduceRows(int row_begin, int row_end, std::vector<BasicErrorSums<T>> &row_sums)
+{
+    for (int yi = row_begin; yi < row_end; yi++)
+    {
+        BasicErrorSums<T> sums;
+        for (int xi = 0; xi < _width; xi++)
+        {
+            BasicPixelErrors<T> pixel;
+            if constexpr (std::is_same<T, double>::value)
+                pixel = _mode == ERROR_MODE_ANALYTIC ? computePixelAnalytic(xi, yi) : computePixel<T>(xi, yi);
+            else
+                pixel = computePixel<T>(xi, yi);
+
+            sums.x += squaredError(pixel.x_error);
+            sums.y += squaredError(pixel.y_error);
+            sums.r += squaredError(pixel.r_error);
+            sums.a += squaredError(pixel.angle_error);
+        }
+        row_sums[yi] = sums;
+    }
+}
+
 void ErrorMapper::run()
 {
-    for (int xi = 0; xi < _width; xi++)
+    _use_vector_kernel = _vectorized && _mode == ERROR_MODE_JITTER && errorKernelVectorAvailable();
+    if (_use_vector_kernel)
+    {
+        // the kernel loads the center and the jittered integrals as separate lanes
+        _if_center.resize(_width);
+        _if_jitter.resize(_width);
+        for (int xi = 0; xi < _width; xi++)
+        {
+            _if_center[xi] = _mapping_tables->_if_curve_integrals[xi * 2];
+            _if_jitter[xi] = _mapping_tables->_if_curve_integrals[xi * 2 + 1];
+        }
+    }
+
+    if (!_parallel)
+    {
+        runRows(0, _height);
+        return;
+    }
+
+    // every pixel only depends on its own row/column tables and is written exactly once,
+    // so the bands produce the same bits as the serial path
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(0, _height, pool.size() * ROW_BANDS_PER_THREAD, [this](int, int row_begin, int row_end)
+                     { runRows(row_begin, row_end); });
+}
+
+void ErrorMapper::runRows(int row_begin, int row_end)
+{
+    for (int yi = row_begin; yi < row_end; yi++)
     {
-        for (int yi = 0; yi < _height; yi++)
+        if (_use_vector_kernel)
+        {
+            runRowVectorized(yi);
+            continue;
+        }
+
+        for (int xi = 0; xi < _width; xi++)
         {
             int index = yi * _width + xi;
 
-            double x = mix(_crop_left, 1.0 - _crop_right, float(xi) / (float(_width) - 1));
-            x = (x - 0.5) * 2;
-
-            Vec4 point_center = mapPoint(x, xi * 2, yi * 2);
-            Vec4 point_right = mapPoint(x + (x <= 0 ? JITTER : -JITTER), xi * 2 + 1, yi * 2);
-            Vec4 point_bottom = mapPoint(x, xi * 2, yi * 2 + 1);
-
-            _result->_x[index] = point_center.r;
-            _result->_y[index] = point_center.g;
-
-            if (xi > 0 && yi < _height - 1)
-            {
-                int t_index = yi * (_width - 1) + (xi - 1);
-
-                unsigned int t1_1 = yi * _width + xi - 1;
-                unsigned int t1_2 = yi * _width + xi;
-                unsigned int t1_3 = (yi + 1) * _width + xi - 1;
-
-                unsigned int t2_1 = yi * _width + xi;
-                unsigned int t2_2 = (yi + 1) * _width + xi;
-                unsigned int t2_3 = (yi + 1) * _width + xi - 1;
-
-                _result->_t[t_index * 6] = t1_1;
-                _result->_t[t_index * 6 + 1] = t1_2;
-                _result->_t[t_index * 6 + 2] = t1_3;
-                _result->_t[t_index * 6 + 3] = t2_1;
-                _result->_t[t_index * 6 + 4] = t2_2;
-                _result->_t[t_index * 6 + 5] = t2_3;
-            }
-
-            double distance_x = Vec4::distance(point_center, point_right);
-            double distance_y = Vec4::distance(point_center, point_bottom);
-
-            double distance_x_norm = (distance_x * 2) / JITTER;
-            double circ_orig = _mapping_tables->_a_x_y[yi * 2] * M_PI * 2;
-            double x_error = distance_x_norm / circ_orig;
-            Vec4 x_col = getErrorColor(x_error);
-            _result->_e_x[index] = std::pow(std::clamp(x_error - 1, -1., 1.), 2);
-            _result->_c_x[index * 3] = x_col.r;
-            _result->_c_x[index * 3 + 1] = x_col.g;
-            _result->_c_x[index * 3 + 2] = x_col.b;
-
-            // y error
-            double distance_y_norm = distance_y / JITTER;
-            double y_error = distance_y_norm / _a;
-            Vec4 y_col = getErrorColor(y_error);
-            _result->_e_y[index] = std::pow(std::clamp(y_error - 1, -1., 1.), 2);
-            _result->_c_y[index * 3] = y_col.r;
-            _result->_c_y[index * 3 + 1] = y_col.g;
-            _result->_c_y[index * 3 + 2] = y_col.b;
-
-            // xy error (average)
-            Vec4 xy_col = mix(x_col, y_col, 0.5);
-            _result->_c_xy[index * 3] = xy_col.r;
-            _result->_c_xy[index * 3 + 1] = xy_col.g;
-            _result->_c_xy[index * 3 + 2] = xy_col.b;
-
-            // relative xy error
-            double r_error = x_error / y_error;
-            Vec4 r_col = getErrorColor(r_error);
-            _result->_e_r[index] = std::pow(std::clamp(r_error - 1, -1., 1.), 2);
-            _result->_c_r[index * 3] = r_col.r;
-            _result->_c_r[index * 3 + 1] = r_col.g;
-            _result->_c_r[index * 3 + 2] = r_col.b;
-
-            // angular error
-            // angle between point_center->point_right and point_center->point_bottom
-            Vec4 up_vector = (point_bottom - point_center).normalize();
-            Vec4 right_vector = (point_right - point_center).normalize();
-            double angle = acos(Vec4::dot(up_vector, right_vector));
-            double angle_error = 1 + (angle - M_PI / 2) / (M_PI / 2);
-            Vec4 angle_col = getErrorColor(angle_error);
-            _result->_e_a[index] = std::pow(std::clamp(angle_error - 1, -1., 1.), 2);
-            _result->_c_a[index * 3] = angle_col.r;
-            _result->_c_a[index * 3 + 1] = angle_col.g;
-            _result->_c_a[index * 3 + 2] = angle_col.b;
+            PixelErrors pixel = _mode == ERROR_MODE_ANALYTIC ? computePixelAnalytic(xi, yi) : computePixel<double>(xi, yi);
+            writePixel(index, pixel);
         }
     }
-}
\ No newline at end of file
+}
+
+double ErrorMapper::getColumnX(int xi)
+{
+    double x = mix(_crop_left, 1.0 - _crop_right, float(xi) / (float(_width) - 1));
+    return (x - 0.5) * 2;
+}
+
+// 2d helpers of the templated error math, same operations as the Vec4 versions
+template <typename T>
+static T distance(const MappedPoint<T> &a, const MappedPoint<T> &b)
+{
+    return sqrt(pow(a.x - b.x, 2) + pow(a.y - b.y, 2));
+}
+
+template <typename T>
+static MappedPoint<T> direction(const MappedPoint<T> &from, const MappedPoint<T> &to)
+{
+    MappedPoint<T> v = {to.x - from.x, to.y - from.y};
+    T len = sqrt(pow(v.x, 2) + pow(v.y, 2));
+    if (len == 0)
+        return {T(0), T(0)};
+    return {v.x / len, v.y / len};
+}
+
+template <typename T>
+BasicPixelErrors<T> ErrorMapper::computePixel(int xi, int yi)
+{
+    double x = getColumnX(xi);
+
+    MappedPoint<T> point_center = mapPoint<T>(x, xi * 2, yi * 2);
+    MappedPoint<T> point_right = mapPoint<T>(x + (x <= 0 ? JITTER : -JITTER), xi * 2 + 1, yi * 2);
+    MappedPoint<T> point_bottom = mapPoint<T>(x, xi * 2, yi * 2 + 1);
+
+    BasicPixelErrors<T> pixel;
+    pixel.x = point_center.x;
+    pixel.y = point_center.y;
+
+    T distance_x = distance(point_center, point_right);
+    T distance_y = distance(point_center, point_bottom);
+
+    T distance_x_norm = (distance_x * 2) / JITTER;
+    double circ_orig = _mapping_tables->_a_x_y[yi * 2] * M_PI * 2;
+    pixel.x_error = distance_x_norm / circ_orig;
+
+    // y error
+    T distance_y_norm = distance_y / JITTER;
+    pixel.y_error = distance_y_norm / _a;
+
+    // relative xy error
+    pixel.r_error = pixel.x_error / pixel.y_error;
+
+    // angular error
+    // angle between point_center->point_right and point_center->point_bottom
+    MappedPoint<T> up_vector = direction(point_center, point_bottom);
+    MappedPoint<T> right_vector = direction(point_center, point_right);
+    T angle = acos(up_vector.x * right_vector.x + up_vector.y * right_vector.y);
+    pixel.angle_error = 1 + (angle - M_PI / 2) / (M_PI / 2);
+
+    return pixel;
+}
+
+// errors from the closed form Jacobian of the mapping instead of the jittered neighbours
+// expects tables set up by Model::setupAnalyticErrorMappingTables (not doubled)
+PixelErrors ErrorMapper::computePixelAnalytic(int xi, int yi)
+{
+    double x = getColumnX(xi);
+
+    Vec4 point(0, 0), d_dx(0, 0), d_dh(0, 0);
+    mapPointJacobian(x, xi, yi, point, d_dx, d_dh);
+
+    PixelErrors pixel;
+    pixel.x = point.r;
+    pixel.y = point.g;
+
+    // |dP/dx| * 2 is the length of the full unrolled row (x in [-1, 1]), compared to the circumference
+    double circ_orig = _mapping_tables->_a_x_y[yi] * M_PI * 2;
+    pixel.x_error = d_dx.length() * 2 / circ_orig;
+
+    // dP/dh is the stretch along the arc-length of the contour
+    pixel.y_error = d_dh.length();
+
+    pixel.r_error = pixel.x_error / pixel.y_error;
+
+    // angle between the direction towards the center column and the direction to the next row
+    Vec4 up_vector = d_dh.normalize();
+    Vec4 right_vector = (d_dx * (x <= 0 ? 1.0 : -1.0)).normalize();
+    double angle = acos(Vec4::dot(up_vector, right_vector));
+    pixel.angle_error = 1 + (angle - M_PI / 2) / (M_PI / 2);
+
+    return pixel;
+}
+
+void ErrorMapper::writePixel(int index, const PixelErrors &pixel)
+{
+    _result->_x[index] = pixel.x;
+    _result->_y[index] = pixel.y;
+
+    Vec4 x_col = getErrorColor(pixel.x_error);
+    _result->_e_x[index] = squaredError(pixel.x_error);
+    _result->_c_x[index * 3] = x_col.r;
+    _result->_c_x[index * 3 + 1] = x_col.g;
+    _result->_c_x[index * 3 + 2] = x_col.b;
+
+    // y error
+    Vec4 y_col = getErrorColor(pixel.y_error);
+    _result->_e_y[index] = squaredError(pixel.y_error);
+    _result->_c_y[index * 3] = y_col.r;
+    _result->_c_y[index * 3 + 1] = y_col.g;
+    _result->_c_y[index * 3 + 2] = y_col.b;
+
+    // xy error (average)
+    Vec4 xy_col = mix(x_col, y_col, 0.5);
+    _result->_c_xy[index * 3] = xy_col.r;
+    _result->_c_xy[index * 3 + 1] = xy_col.g;
+    _result->_c_xy[index * 3 + 2] = xy_col.b;
+
+    // relative xy error
+    Vec4 r_col = getErrorColor(pixel.r_error);
+    _result->_e_r[index] = squaredError(pixel.r_error);
+    _result->_c_r[index * 3] = r_col.r;
+    _result->_c_r[index * 3 + 1] = r_col.g;
+    _result->_c_r[index * 3 + 2] = r_col.b;
+
+    // angular error
+    Vec4 angle_col = getErrorColor(pixel.angle_error);
+    _result->_e_a[index] = squaredError(pixel.angle_error);
+    _result->_c_a[index * 3] = angle_col.r;
+    _result->_c_a[index * 3 + 1] = angle_col.g;
+    _result->_c_a[index * 3 + 2] = angle_col.b;
+}
+
+void ErrorMapper::runRowVectorized(int yi)
+{
+    double r_center = getRadiusIF(yi * 2, _IF) * _rad_factor;
+    double r_bottom = getRadiusIF(yi * 2 + 1, _IF) * _rad_factor;
+
+    ErrorKernelRow row;
+    row.r_center = r_center;
+    row.r_bottom = r_bottom;
+    row.cp_center = _a - double(_mapping_tables->_x_a_x[yi * 2]) + r_center;
+    row.cp_bottom = _a - double(_mapping_tables->_x_a_x[yi * 2 + 1]) + r_bottom;
+    row.r_orig_center = _mapping_tables->_a_x_y[yi * 2];
+    row.r_fit_center = _mapping_tables->_linear_fit[yi * 2];
+    row.r_orig_bottom = _mapping_tables->_a_x_y[yi * 2 + 1];
+    row.r_fit_bottom = _mapping_tables->_linear_fit[yi * 2 + 1];
+    row.circ_orig = _mapping_tables->_a_x_y[yi * 2] * M_PI * 2;
+
+    ErrorKernelParams params = {_width, float(_a), float(_tilt), float(_crop_left), float(_crop_right), JITTER, _if_center.data(), _if_jitter.data()};
+    ErrorKernelOutput out = {_result->_x, _result->_y, _result->_e_x, _result->_e_y, _result->_e_r, _result->_e_a,
+                             _result->_c_x, _result->_c_y, _result->_c_xy, _result->_c_r, _result->_c_a};
+
+    errorKernelVectorRow(params, row, out, yi);
+}
@@ -5,10 +5,15 @@
 #include <fstream>
 #include <vector>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
 
 #include "util.hpp"
+#include "dual.hpp"
 
 #include "shader.hpp"
+#include "thread_pool.hpp"
+#include "cpu_error_kernel.hpp"
 
 //********************************/
 // CPUErrorMapResult implementation
@@ -25,7 +30,7 @@ public:
 
         _x = new float[size];
         _y = new float[size];
-        _t = new unsigned int[size * 2 * 3];
+        _t = getGridTriangles(width, height);
         _e_x = new double[size];
         _e_y = new double[size];
         _e_r = new double[size];
@@ -41,7 +46,6 @@ public:
     {
         delete[] _x;
         delete[] _y;
-        delete[] _t;
         delete[] _e_x;
         delete[] _e_y;
         delete[] _e_r;
@@ -72,33 +76,33 @@ public:
 
     RenderData getRenderDataXError()
     {
-        return {_x, _y, _c_x, _t};
+        return {_x, _y, _c_x, _t->data()};
     }
 
     RenderData getRenderDataYError()
     {
-        return {_x, _y, _c_y, _t};
+        return {_x, _y, _c_y, _t->data()};
     }
 
     RenderData getRenderDataXYError()
     {
-        return {_x, _y, _c_xy, _t};
+        return {_x, _y, _c_xy, _t->data()};
     }
 
     RenderData getRenderDataRError()
     {
-        return {_x, _y, _c_r, _t};
+        return {_x, _y, _c_r, _t->data()};
     }
 
     RenderData getRenderDataAError()
     {
-        return {_x, _y, _c_a, _t};
+        return {_x, _y, _c_a, _t->data()};
     }
 
     int _width = 0, _height = 0, _size = 0;
     float *_x;
     float *_y;
-    unsigned int *_t;
+    std::shared_ptr<const std::vector<unsigned int>> _t; // shared grid topology
     double *_e_x; // error in x direction
     double *_e_y; // error in y direction
     double *_e_r; // error relative x/y
@@ -110,6 +114,78 @@ public:
     float *_c_a;
 };
 
+// squared error as stored in the _e_* arrays
+inline double squaredError(double error)
+{
+    return std::pow(std::clamp(error - 1, -1., 1.), 2);
+}
+
+// the derivative is 0 where the error is clamped
+inline Dual squaredError(const Dual &error)
+{
+    Dual e = error - 1;
+    if (e.v < -1 || e.v > 1)
+        return Dual(1);
+    return e * e;
+}
+
+// sums of the squared errors over the whole grid
+template <typename T>
+struct BasicErrorSums
+{
+    T x = 0, y = 0, r = 0, a = 0;
+
+    void add(const BasicErrorSums &other)
+    {
+        x += other.x;
+        y += other.y;
+        r += other.r;
+        a += other.a;
+    }
+
+    // same weighting as CPUErrorMapResult::getWeightedError summed over all pixels
+    T weighted(float x_weight, float y_weight, float r_weight, float a_weight) const
+    {
+        float total_weight = x_weight + y_weight + r_weight + a_weight;
+        if (total_weight == 0)
+            return 0;
+        return x * (x_weight / total_weight) + y * (y_weight / total_weight) + r * (r_weight / total_weight) + a * (a_weight / total_weight);
+    }
+};
+
+typedef BasicErrorSums<double> ErrorSums;
+typedef BasicErrorSums<Dual> DualErrorSums; // sums and their gradient
+
+// raw (unsquared) errors of a single pixel, 1 means no distortion
+template <typename T>
+struct BasicPixelErrors
+{
+    T x, y; // mapped point
+    T x_error, y_error, r_error, angle_error;
+};
+
+typedef BasicPixelErrors<double> PixelErrors;
+
+template <typename T>
+struct MappedPoint
+{
+    T x, y;
+};
+
+// entries of the jittered error mapping tables that depend on the optimized parameters,
+// with their derivatives (same layout as MappingTables, see Model::setupErrorMappingTableGradients)
+struct MappingTableGradients
+{
+    std::vector<Dual> _if_curve_integrals;
+    std::vector<Dual> _x_a_x;
+};
+
+enum ErrorMode
+{
+    ERROR_MODE_JITTER,  // finite differences with jittered neighbours, tables from Model::setupErrorMappingTables
+    ERROR_MODE_ANALYTIC // closed form Jacobian, tables from Model::setupAnalyticErrorMappingTables
+};
+
 class ErrorMapper
 {
 public:
@@ -119,16 +195,70 @@ public:
 
     void setParams(int width, int height, double a, double IF, double rad_factor, MappingTables *mapping_tables, double tilt, double crop_left, double crop_right);
 
-    Vec4 getCirclePoint(double r, Vec4 cp, double arc_offset);
-    double getRadiusIF(int yi, double cIF);
+    // the mapping math is templated over double and Dual (value + gradient)
+    template <typename T>
+    MappedPoint<T> getCirclePoint(T r, T cp_y, T arc_offset);
+    template <typename T>
+    T getRadiusIF(int yi, T cIF);
+    template <typename T>
+    MappedPoint<T> mapPoint(double x, int xi, int yi);
 
-    Vec4 mapPoint(double x, int xi, int yi);
+    // parameters and parameter dependent table entries as double or as Dual
+    template <typename T>
+    void getParams(T &IF, T &rad_factor);
+    template <typename T>
+    T getIntegral(int xi);
+    template <typename T>
+    T getHeight(int yi);
+    void mapPointJacobian(double x, int xi, int yi, Vec4 &point, Vec4 &d_dx, Vec4 &d_dh);
 
     void map(int width, int height, MappingTables *mapping_tables, float arc_length, float interpolation_factor, float radius_modifier, float tilt, float crop_left, float crop_right);
+    ErrorSums reduce(int width, int height, MappingTables *mapping_tables, float arc_length, float interpolation_factor, float radius_modifier, float tilt, float crop_left, float crop_right);
+    DualErrorSums reduceGradient(int width, int height, MappingTables *mapping_tables, const MappingTableGradients *gradients, float arc_length, Dual interpolation_factor, Dual radius_modifier, float tilt, float crop_left, float crop_right);
+    template <typename T>
+    BasicErrorSums<T> reduceAll(std::vector<BasicErrorSums<T>> &row_sums);
+    template <typename T>
+    void reduceRows(int row_begin, int row_end, std::vector<BasicErrorSums<T>> &row_sums);
     void run();
+    void runRows(int row_begin, int row_end);
+    void runRowVectorized(int yi);
+    double getColumnX(int xi);
+    template <typename T>
+    BasicPixelErrors<T> computePixel(int xi, int yi);
+    PixelErrors computePixelAnalytic(int xi, int yi);
+    void writePixel(int index, const PixelErrors &pixel);
+
+    // parallel mode splits the grid into row bands on the shared thread pool
+    void setParallel(bool parallel)
+    {
+        _parallel = parallel;
+    }
+
+    // vectorized mode uses the float SIMD kernel (cpu_error_kernel.hpp) if the cpu supports it
+    void setVectorized(bool vectorized)
+    {
+        _vectorized = vectorized;
+    }
+
+    // the mode has to match the layout of the mapping tables passed to map()
+    // the vectorized kernel is only available for ERROR_MODE_JITTER
+    void setMode(ErrorMode mode)
+    {
+        _mode = mode;
+    }
 
     int _width = 0, _height = 0, _size = 0;
     double _a, _IF, _rad_factor, _tilt, _crop_left, _crop_right;
+    bool _parallel = true;
+    bool _vectorized = false;
+    ErrorMode _mode = ERROR_MODE_JITTER;
+    bool _use_vector_kernel = false;
+    std::vector<float> _if_center; // de-interleaved IF curve integral table for the vectorized kernel
+    std::vector<float> _if_jitter;
+    std::vector<ErrorSums> _row_sums; // per row partial sums of reduce()
+    std::vector<DualErrorSums> _row_sums_gradient;
+    Dual _IF_gradient, _rad_factor_gradient; // parameters of reduceGradient()
+    const MappingTableGradients *_gradients = nullptr;
     MappingTables *_mapping_tables = nullptr;
     CPUErrorMapResult *_result = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "cpu_grid_mapper.hpp"
+
+//********************************/
+// CPUGridMapper implementation
+
+#define GRID_LINE_BANDS_PER_THREAD 2
+
+CPUGridMapper::~CPUGridMapper()
+{
+    if (_result != nullptr)
+    {
+        delete _result;
+    }
+}
+
+void CPUGridMapper::setSize(int width, int height)
+{
+    assert(width > 1 && height > 1 && "Called setSize with invalid size");
+
+    if (width == _width && height == _height)
+        return;
+
+    delete _result;
+
+    _width = width;
+    _height = height;
+    _result = new GridMapResult(width, height);
+}
+
+void CPUGridMapper::map(int width, int height, MappingTables &horizontal_tables, MappingTables &vertical_tables, float arc_length, float interpolation_factor,
+                     float radius_modifier, float tilt, float crop_left, float crop_right)
+{
+    setSize(width, height);
+
+    // rotation, shift and vertical crop only move the texture, not the mapped points
+    ImageKernelParams horizontal = {GRID_SUBDIVISIONS, height, arc_length, interpolation_factor, radius_modifier, tilt,
+                                    0.f, 0.f, 0.f, 0.f, crop_left, crop_right,
+                                    horizontal_tables._if_curve_integrals, horizontal_tables._x_a_x, horizontal_tables._a_x_y, horizontal_tables._linear_fit,
+                                    nullptr, 0, 0};
+    ImageKernelParams vertical = {width, GRID_SUBDIVISIONS, arc_length, interpolation_factor, radius_modifier, tilt,
+                                  0.f, 0.f, 0.f, 0.f, crop_left, crop_right,
+                                  vertical_tables._if_curve_integrals, vertical_tables._x_a_x, vertical_tables._a_x_y, vertical_tables._linear_fit,
+                                  nullptr, 0, 0};
+
+    std::vector<WarpRow> horizontal_rows, vertical_rows;
+    float min_x, max_x, min_y, max_y; // not needed
+    setupWarpRows(horizontal, horizontal_rows, min_x, max_x, min_y, max_y);
+    setupWarpRows(vertical, vertical_rows, min_x, max_x, min_y, max_y);
+
+    float *out_x = _result->_r_x.data();
+    float *out_y = _result->_r_y.data();
+
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(0, width + height, pool.size() * GRID_LINE_BANDS_PER_THREAD, [&](int, int begin, int end)
+                     {
+        for (int line = begin; line < end; line++)
+        {
+            int first = line * GRID_SUBDIVISIONS;
+            if (line < height)
+            {
+                // horizontal line: one row, GRID_SUBDIVISIONS columns
+                const WarpRow &row = horizontal_rows[line];
+                for (int v = 0; v < GRID_SUBDIVISIONS; v++)
+                {
+                    getWarpPoint(horizontal, row, getArcOffset(horizontal, row, v), out_x[first + v], out_y[first + v]);
+                }
+            }
+            else
+            {
+                // vertical line: one column, GRID_SUBDIVISIONS rows
+                int column = line - height;
+                for (int v = 0; v < GRID_SUBDIVISIONS; v++)
+                {
+                    const WarpRow &row = vertical_rows[v];
+                    getWarpPoint(vertical, row, getArcOffset(vertical, row, column), out_x[first + v], out_y[first + v]);
+                }
+            }
+        } });
+}
\ No newline at end of file
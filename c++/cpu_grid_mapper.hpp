@@ -0,0 +1,67 @@
+#pragma once
+
+#include <assert.h>
+#include <vector>
+
+#include "util.hpp"
+#include "thread_pool.hpp"
+#include "cpu_image_mapper.hpp"
+
+//********************************/
+// GridMapResult implementation
+
+// GRID_SUBDIVISIONS points per line: first the horizontal lines (top to bottom), then the
+// vertical lines (left to right)
+class GridMapResult
+{
+public:
+    GridMapResult(int width, int height)
+    {
+        int lines = width + height;
+        _r_x.resize(lines * GRID_SUBDIVISIONS);
+        _r_y.resize(lines * GRID_SUBDIVISIONS);
+
+        // the topology only depends on the number of lines
+        _r_l.reserve(lines * (GRID_SUBDIVISIONS - 1) * 2);
+        for (int line = 0; line < lines; line++)
+        {
+            for (int v = 1; v < GRID_SUBDIVISIONS; v++)
+            {
+                _r_l.push_back(line * GRID_SUBDIVISIONS + v - 1);
+                _r_l.push_back(line * GRID_SUBDIVISIONS + v);
+            }
+        }
+    }
+
+    RenderData getRenderData()
+    {
+        return {_r_x.data(), _r_y.data(), nullptr, _r_l.data()};
+    }
+
+    std::vector<float> _r_x;
+    std::vector<float> _r_y;
+    std::vector<unsigned int> _r_l; // line buffer
+};
+
+//********************************/
+// CPUGridMapper implementation
+
+// maps the lines of a width x height grid: every line point is evaluated exactly through the
+// mapping (same semicircles as CPUImageMapper::warp), the lines are mapped in parallel
+class CPUGridMapper
+{
+public:
+    CPUGridMapper() = default;
+
+    ~CPUGridMapper();
+
+    int _width = 0, _height = 0;
+    GridMapResult *_result = nullptr;
+
+    void setSize(int width, int height);
+
+    // horizontal_tables: GRID_SUBDIVISIONS x height, the columns of the horizontal lines
+    // vertical_tables: width x GRID_SUBDIVISIONS, the rows of the vertical lines
+    void map(int width, int height, MappingTables &horizontal_tables, MappingTables &vertical_tables, float arc_length, float interpolation_factor,
+             float radius_modifier, float tilt, float crop_left, float crop_right);
+};
\ No newline at end of file
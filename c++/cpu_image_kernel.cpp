@@ -0,0 +1,128 @@
+#include "cpu_image_kernel.hpp"
+
+#include "simd.hpp"
+
+//********************************/
+// Vectorized image mapping kernel implementation
+//
+// Mirrors CPUImageMapper::mapRow with float lanes, the positions differ from the scalar path
+// only by the sin/cos approximation documented in simd.hpp.
+
+#if defined(ANROLL_HAS_VECTOR_EXTENSIONS)
+
+// GL_LINEAR + GL_REPEAT sample of the RGBA image, texels that are not fully opaque turn white
+static inline void sampleImage(const ImageKernelParams &params, vfloat8 s, vfloat8 t, int lanes, vfloat8 &r, vfloat8 &g, vfloat8 &b)
+{
+    float iw = float(params.image_width), ih = float(params.image_height);
+
+    vfloat8 u = s * iw - 0.5f;
+    vfloat8 v = t * ih - 0.5f;
+    u = u - iw * vfloor(u / iw);
+    v = v - ih * vfloor(v / ih);
+    vfloat8 u0 = vmin(vfloor(u), vset(iw - 1.f));
+    vfloat8 v0 = vmin(vfloor(v), vset(ih - 1.f));
+    vfloat8 fu = u - u0, fv = v - v0;
+
+    vint8 i0 = __builtin_convertvector(u0, vint8);
+    vint8 j0 = __builtin_convertvector(v0, vint8);
+    vint8 i1 = i0 + 1, j1 = j0 + 1;
+    i1 &= ~(i1 == params.image_width);
+    j1 &= ~(j1 == params.image_height);
+
+    // texel fetches are scalar, the filtering is done per lane
+    vfloat8 texels[4][4] = {}; // [corner][channel]
+    for (int l = 0; l < lanes; l++)
+    {
+        const unsigned char *row0 = params.image + size_t(j0[l]) * params.image_width * 4;
+        const unsigned char *row1 = params.image + size_t(j1[l]) * params.image_width * 4;
+        const unsigned char *corners[4] = {row0 + i0[l] * 4, row0 + i1[l] * 4, row1 + i0[l] * 4, row1 + i1[l] * 4};
+        for (int k = 0; k < 4; k++)
+        {
+            for (int ch = 0; ch < 4; ch++)
+            {
+                texels[k][ch][l] = corners[k][ch];
+            }
+        }
+    }
+
+    vfloat8 filtered[4];
+    for (int ch = 0; ch < 4; ch++)
+    {
+        vfloat8 top = texels[0][ch] * (1.f - fu) + texels[1][ch] * fu;
+        vfloat8 bottom = texels[2][ch] * (1.f - fu) + texels[3][ch] * fu;
+        filtered[ch] = top * (1.f - fv) + bottom * fv;
+    }
+
+    // pixel.a < 1.0 after the conversion to 8 bit
+    vint8 opaque = filtered[3] >= 254.5f;
+    r = vselect(opaque, filtered[0] * (1.f / 255.f), vset(1.f));
+    g = vselect(opaque, filtered[1] * (1.f / 255.f), vset(1.f));
+    b = vselect(opaque, filtered[2] * (1.f / 255.f), vset(1.f));
+}
+
+bool imageKernelVectorAvailable()
+{
+#if defined(__AVX2__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return true;
+#endif
+}
+
+void imageKernelVectorRow(const ImageKernelParams &params, const ImageKernelOutput &out, int yi)
+{
+    const int width = params.width;
+    const float step = 1.f / (float(width) - 1);
+
+    float r_orig = params.a_x_y[yi];
+    float r_fit = params.linear_fit[yi];
+    float sc_rad = (r_fit + (r_orig - r_fit) * params.interpolation_factor) * params.radius_modifier;
+    float sc_cp = params.a - params.x_a_x[yi] + sc_rad;
+    float y_tex = getImageTexY(params, yi);
+
+    for (int xi0 = 0; xi0 < width; xi0 += SIMD_LANES)
+    {
+        int lanes = width - xi0 < SIMD_LANES ? width - xi0 : SIMD_LANES;
+
+        vfloat8 xi, area;
+        for (int l = 0; l < SIMD_LANES; l++)
+        {
+            int column = l < lanes ? xi0 + l : width - 1;
+            xi[l] = float(column);
+            area[l] = params.if_curve_integrals[column];
+        }
+
+        vfloat8 t = xi * step;
+        vfloat8 x_crop = params.crop_left * (1.f - t) + (1.f - params.crop_right) * t;
+        vfloat8 x = (x_crop - 0.5f) * 2.f;
+
+        vfloat8 px, py;
+        circlePoint(sc_rad, sc_cp, params.tilt, arcOffset(x, area, r_orig, r_fit), px, py);
+
+        vfloat8 r, g, b;
+        sampleImage(params, x_crop + (1.f - params.image_rotation), vset(y_tex), lanes, r, g, b);
+
+        int index = yi * width + xi0;
+        for (int l = 0; l < lanes; l++)
+        {
+            out.x[index + l] = px[l];
+            out.y[index + l] = py[l];
+            out.c[(index + l) * 3] = r[l];
+            out.c[(index + l) * 3 + 1] = g[l];
+            out.c[(index + l) * 3 + 2] = b[l];
+        }
+    }
+}
+
+#else
+
+bool imageKernelVectorAvailable()
+{
+    return false;
+}
+
+void imageKernelVectorRow(const ImageKernelParams &, const ImageKernelOutput &, int)
+{
+}
+
+#endif
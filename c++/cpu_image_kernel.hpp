@@ -0,0 +1,41 @@
+#pragma once
+
+//********************************/
+// Vectorized image mapping kernel
+//
+// Maps one row of the image mesh 8 vertices at a time (see image_map.comp). Like the error
+// kernel the interface only uses plain data, so cpu_image_kernel.cpp can be compiled for AVX2.
+
+struct ImageKernelParams
+{
+    int width, height;
+    float a, interpolation_factor, radius_modifier, tilt;
+    float image_rotation, vertical_shift;
+    float crop_bottom, crop_top, crop_left, crop_right;
+    const float *if_curve_integrals, *x_a_x, *a_x_y, *linear_fit; // MappingTables
+    const unsigned char *image; // RGBA
+    int image_width, image_height;
+};
+
+struct ImageKernelOutput
+{
+    float *x, *y, *c;
+};
+
+// texture coordinates of a (fractional) mesh vertex (image_map.comp: x_tex, y_tex)
+inline float getImageTexX(const ImageKernelParams &params, float xi)
+{
+    float t = xi / (float(params.width) - 1);
+    return params.crop_left * (1 - t) + (1.f - params.crop_right) * t + (1 - params.image_rotation);
+}
+
+inline float getImageTexY(const ImageKernelParams &params, float yi)
+{
+    float t = yi / (float(params.height) - 1);
+    return params.crop_top * (1 - t) + (1.f - params.crop_bottom) * t + params.vertical_shift;
+}
+
+// true if the kernel was built and the cpu supports the instruction set it was built for
+bool imageKernelVectorAvailable();
+
+void imageKernelVectorRow(const ImageKernelParams &params, const ImageKernelOutput &out, int yi);
@@ -0,0 +1,522 @@
+#include "cpu_image_mapper.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+//********************************/
+// CPUImageMapper implementation
+
+#define ROW_BANDS_PER_THREAD 4
+
+CPUImageMapper::~CPUImageMapper()
+{
+    if (_result != nullptr)
+    {
+        delete _result;
+    }
+}
+
+void CPUImageMapper::setSize(int width, int height)
+{
+    assert(width != 0 && "Called setSize with invalid width");
+
+    if (width == _width && height == _height)
+        return;
+
+    if (_result != nullptr)
+    {
+        delete _result;
+    }
+
+    _width = width;
+    _height = height;
+    _size = width * height;
+
+    _result = new ImageMapResult(width, height);
+}
+
+void CPUImageMapper::loadImage(int width, int height, const unsigned char *image)
+{
+    _image = image;
+    _image_width = width;
+    _image_height = height;
+}
+
+void CPUImageMapper::map(int width, int height, MappingTables &mapping_tables, float arc_length, float interpolation_factor, float radius_modifier,
+                         float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right)
+{
+    assert(_image != nullptr && "Called map without an image");
+
+    setSize(width, height);
+
+    ImageKernelParams params = {width, height, arc_length, interpolation_factor, radius_modifier, tilt,
+                                image_rotation, vertical_shift, crop_bottom, crop_top, crop_left, crop_right,
+                                mapping_tables._if_curve_integrals, mapping_tables._x_a_x, mapping_tables._a_x_y, mapping_tables._linear_fit,
+                                _image, _image_width, _image_height};
+    ImageKernelOutput out = {_result->_x, _result->_y, _result->_c};
+    bool use_vector_kernel = _vectorized && imageKernelVectorAvailable();
+
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(0, _height, pool.size() * ROW_BANDS_PER_THREAD, [&](int, int row_begin, int row_end)
+                     {
+        for (int yi = row_begin; yi < row_end; yi++)
+        {
+            if (use_vector_kernel)
+                imageKernelVectorRow(params, out, yi);
+            else
+                mapRow(params, yi);
+        } });
+}
+
+void CPUImageMapper::mapRow(const ImageKernelParams &params, int yi)
+{
+    float r_orig = params.a_x_y[yi];
+    float r_fit = params.linear_fit[yi];
+    float sc_rad = (r_fit + (r_orig - r_fit) * params.interpolation_factor) * params.radius_modifier;
+    float sc_cp = params.a - params.x_a_x[yi] + sc_rad;
+    float y_tex = getImageTexY(params, yi);
+
+    for (int xi = 0; xi < _width; xi++)
+    {
+        int index = yi * _width + xi;
+
+        float t = float(xi) / (float(_width) - 1);
+        float x = params.crop_left * (1 - t) + (1.f - params.crop_right) * t;
+        x = (x - 0.5f) * 2;
+
+        float arc_offset = 0.f;
+        if (x != 0.f)
+        {
+            float area = params.if_curve_integrals[xi];
+            float circ = (r_fit + (r_orig - r_fit) * (area / std::abs(x))) * float(M_PI) * 2;
+            arc_offset = circ / 2 * x;
+        }
+
+        float phi = arc_offset / sc_rad;
+        float y = sc_cp - sc_rad * std::cos(phi);
+        _result->_x[index] = sc_rad * std::sin(phi);
+        _result->_y[index] = y * (1 - params.tilt) + (sc_cp - sc_rad) * params.tilt;
+
+        sampleTexture(params.image, params.image_width, params.image_height, getImageTexX(params, xi), y_tex, &_result->_c[index * 3]);
+    }
+}
+
+//********************************/
+// Backward warp
+
+float getArcOffset(const ImageKernelParams &params, const WarpRow &row, int xi)
+{
+    float t = float(xi) / (float(params.width) - 1);
+    float x = params.crop_left * (1 - t) + (1.f - params.crop_right) * t;
+    x = (x - 0.5f) * 2;
+    if (x == 0.f)
+        return 0.f;
+    return float(M_PI) * x * (row.r_fit + (row.r_orig - row.r_fit) * (params.if_curve_integrals[xi] / std::abs(x)));
+}
+
+void getWarpPoint(const ImageKernelParams &params, const WarpRow &row, float arc_offset, float &x, float &y)
+{
+    float phi = arc_offset / row.radius;
+    x = row.radius * std::sin(phi);
+    y = row.cp - row.radius * ((1 - params.tilt) * std::cos(phi) + params.tilt);
+}
+
+void setupWarpRows(const ImageKernelParams &params, std::vector<WarpRow> &rows, float &min_x, float &max_x, float &min_y, float &max_y)
+{
+    rows.resize(params.height);
+    min_x = INFINITY, max_x = -INFINITY, min_y = INFINITY, max_y = -INFINITY;
+    for (int yi = 0; yi < params.height; yi++)
+    {
+        WarpRow &row = rows[yi];
+        row.r_orig = params.a_x_y[yi];
+        row.r_fit = params.linear_fit[yi];
+        row.radius = (row.r_fit + (row.r_orig - row.r_fit) * params.interpolation_factor) * params.radius_modifier;
+        row.cp = params.a - params.x_a_x[yi] + row.radius;
+        row.arc_begin = getArcOffset(params, row, 0);
+        row.arc_end = getArcOffset(params, row, params.width - 1);
+        row.min_y = INFINITY;
+        row.max_y = -INFINITY;
+
+        float arcs[3] = {row.arc_begin, row.arc_end, 0.f};
+        for (int k = 0; k < (row.arc_begin < 0 && row.arc_end > 0 ? 3 : 2); k++)
+        {
+            float x, y;
+            getWarpPoint(params, row, arcs[k], x, y);
+            min_x = std::min(min_x, x);
+            max_x = std::max(max_x, x);
+            min_y = std::min(min_y, y);
+            max_y = std::max(max_y, y);
+            row.min_y = std::min(row.min_y, y);
+            row.max_y = std::max(row.max_y, y);
+        }
+    }
+}
+
+static inline unsigned char toUnorm8(float value)
+{
+    return (unsigned char)(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+#define WARP_COLUMN_BANDS_PER_THREAD 4
+
+// pixel grid of the warped image over the bounds of the mapped mesh
+struct WarpTarget
+{
+    float min_x, min_y;
+    float pixel_x, scale_y;
+    int width, height;
+};
+
+// warps the output rows [band_begin, band_end) into band (target.width x band rows, RGBA). only the
+// cells between the mapping rows yi and yi + 1 of pairs (ascending) are drawn
+static void warpColumns(const ImageKernelParams &params, const std::vector<WarpRow> &rows, const WarpTarget &target,
+                        int band_begin, int band_end, const std::vector<int> &pairs, unsigned char *band)
+{
+    // rows of the cells, ascending
+    std::vector<int> needed;
+    for (int yi : pairs)
+    {
+        if (needed.empty() || needed.back() < yi)
+            needed.push_back(yi);
+        needed.push_back(yi + 1);
+    }
+
+    int width = params.width, height = params.height;
+
+    // the columns of the image are independent: every column intersects all rows and fills the
+    // pixels between two consecutive rows, later rows overwrite earlier ones like the mesh triangles
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(0, target.width, pool.size() * WARP_COLUMN_BANDS_PER_THREAD, [&](int, int column_begin, int column_end)
+                     {
+        std::vector<char> valid(height);
+        std::vector<float> window_y(height);
+        std::vector<float> source_x(height);
+        std::vector<int> cursor(height, -1); // arc offsets grow with x, so the column search only moves right
+        std::vector<float> cursor_arc(height * 2); // arc offsets of the columns cursor and cursor + 1
+
+        for (int px = column_begin; px < column_end; px++)
+        {
+            float x = target.min_x + (px + 0.5f) * target.pixel_x;
+
+            for (int yi : needed)
+            {
+                const WarpRow &row = rows[yi];
+                valid[yi] = false;
+                if (std::abs(x) >= std::abs(row.radius))
+                    continue;
+                float phi = std::asin(x / row.radius);
+                float arc_offset = phi * row.radius;
+                if (arc_offset < row.arc_begin || arc_offset > row.arc_end)
+                    continue;
+
+                int &xi = cursor[yi];
+                if (xi < 0)
+                {
+                    // first column of the band on this row
+                    int lo = 0, hi = width - 2;
+                    while (lo < hi)
+                    {
+                        int mid = (lo + hi + 1) / 2;
+                        if (getArcOffset(params, row, mid) <= arc_offset)
+                            lo = mid;
+                        else
+                            hi = mid - 1;
+                    }
+                    xi = lo;
+                    cursor_arc[yi * 2] = getArcOffset(params, row, xi);
+                    cursor_arc[yi * 2 + 1] = getArcOffset(params, row, xi + 1);
+                }
+                float &arc_0 = cursor_arc[yi * 2];
+                float &arc_1 = cursor_arc[yi * 2 + 1];
+                while (xi < width - 2 && arc_1 <= arc_offset)
+                {
+                    xi++;
+                    arc_0 = arc_1;
+                    arc_1 = getArcOffset(params, row, xi + 1);
+                }
+                source_x[yi] = xi + (arc_1 > arc_0 ? std::clamp((arc_offset - arc_0) / (arc_1 - arc_0), 0.f, 1.f) : 0.f);
+
+                float y = row.cp - row.radius * ((1 - params.tilt) * std::cos(phi) + params.tilt);
+                window_y[yi] = target.height - (y - target.min_y) * target.scale_y;
+                valid[yi] = true;
+            }
+
+            for (int yi : pairs)
+            {
+                if (!valid[yi] || !valid[yi + 1] || window_y[yi] == window_y[yi + 1])
+                    continue;
+
+                float y_0 = window_y[yi], y_1 = window_y[yi + 1];
+                int py_begin = std::max(band_begin, int(std::ceil(std::min(y_0, y_1) - 0.5f)));
+                int py_end = std::min(band_end, int(std::ceil(std::max(y_0, y_1) - 0.5f))); // exclusive
+                for (int py = py_begin; py < py_end; py++)
+                {
+                    float f = (py + 0.5f - y_0) / (y_1 - y_0);
+                    float xi = source_x[yi] + (source_x[yi + 1] - source_x[yi]) * f;
+
+                    float rgb[3];
+                    sampleTexture(params.image, params.image_width, params.image_height, getImageTexX(params, xi), getImageTexY(params, yi + f), rgb);
+                    unsigned char *out = &band[(size_t(py - band_begin) * target.width + px) * 4];
+                    out[0] = toUnorm8(rgb[0]);
+                    out[1] = toUnorm8(rgb[1]);
+                    out[2] = toUnorm8(rgb[2]);
+                    out[3] = 255;
+                }
+            }
+        } });
+}
+
+RenderResult CPUImageMapper::warp(CPURenderer &renderer, int render_size, int width, int height, MappingTables &mapping_tables, float arc_length, float interpolation_factor, float radius_modifier,
+                                  float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right)
+{
+    assert(_image != nullptr && "Called warp without an image");
+
+    ImageKernelParams params = {width, height, arc_length, interpolation_factor, radius_modifier, tilt,
+                                image_rotation, vertical_shift, crop_bottom, crop_top, crop_left, crop_right,
+                                mapping_tables._if_curve_integrals, mapping_tables._x_a_x, mapping_tables._a_x_y, mapping_tables._linear_fit,
+                                _image, _image_width, _image_height};
+
+    std::vector<WarpRow> rows;
+    float min_x, max_x, min_y, max_y;
+    setupWarpRows(params, rows, min_x, max_x, min_y, max_y);
+
+    RenderResult result = renderer.beginImage(min_x, max_x, min_y, max_y, render_size);
+    int render_width = int(result.width), render_height = int(result.height);
+    WarpTarget target = {min_x, min_y, (max_x - min_x) / render_width, render_height / (max_y - min_y), render_width, render_height};
+
+    std::vector<int> pairs(std::max(height - 1, 0));
+    std::iota(pairs.begin(), pairs.end(), 0);
+    warpColumns(params, rows, target, 0, render_height, pairs, renderer._output_buffer.data());
+
+    return result;
+}
+
+RenderResult CPUImageMapper::warpBands(int render_size, int band_height, int width, int height, MappingTables &mapping_tables, float arc_length, float interpolation_factor, float radius_modifier,
+                                       float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right,
+                                       const std::function<bool(const RenderResult &, int, int)> &consume)
+{
+    assert(_image != nullptr && "Called warpBands without an image");
+
+    ImageKernelParams params = {width, height, arc_length, interpolation_factor, radius_modifier, tilt,
+                                image_rotation, vertical_shift, crop_bottom, crop_top, crop_left, crop_right,
+                                mapping_tables._if_curve_integrals, mapping_tables._x_a_x, mapping_tables._a_x_y, mapping_tables._linear_fit,
+                                _image, _image_width, _image_height};
+
+    std::vector<WarpRow> rows;
+    float min_x, max_x, min_y, max_y;
+    setupWarpRows(params, rows, min_x, max_x, min_y, max_y);
+
+    int render_width, render_height;
+    CPURenderer::getRenderSize(render_size, std::abs(max_y - min_y) / std::abs(max_x - min_x), render_width, render_height);
+    WarpTarget target = {min_x, min_y, (max_x - min_x) / render_width, render_height / (max_y - min_y), render_width, render_height};
+
+    band_height = std::clamp(band_height, 1, render_height);
+    std::vector<unsigned char> band(size_t(render_width) * band_height * 4);
+    std::vector<int> pairs;
+    for (int band_begin = 0; band_begin < render_height; band_begin += band_height)
+    {
+        int band_end = std::min(render_height, band_begin + band_height);
+
+        // cells that reach into the band (one pixel margin), window rows grow downwards in y
+        float band_min_y = min_y + (render_height - band_end - 1) / target.scale_y;
+        float band_max_y = min_y + (render_height - band_begin + 1) / target.scale_y;
+        pairs.clear();
+        for (int yi = 0; yi < height - 1; yi++)
+        {
+            if (std::min(rows[yi].min_y, rows[yi + 1].min_y) <= band_max_y && std::max(rows[yi].max_y, rows[yi + 1].max_y) >= band_min_y)
+                pairs.push_back(yi);
+        }
+
+        // glClearColor(1.0, 1.0, 1.0, 0.0) like CPURenderer::clear
+        for (size_t i = 0; i < size_t(render_width) * (band_end - band_begin) * 4; i += 4)
+        {
+            band[i] = 255;
+            band[i + 1] = 255;
+            band[i + 2] = 255;
+            band[i + 3] = 0;
+        }
+        warpColumns(params, rows, target, band_begin, band_end, pairs, band.data());
+
+        if (!consume({band.data(), size_t(render_width), size_t(band_end - band_begin)}, band_begin, render_height))
+            break;
+    }
+
+    return {nullptr, size_t(render_width), size_t(render_height)};
+}
+
+//********************************/
+// Adaptive tessellation
+
+#define ADAPTIVE_MIN_CELLS 4   // initial cells per direction, a midpoint test alone can miss symmetric bends
+#define ADAPTIVE_PROBE_ROWS 17 // rows the column selection is tested on
+#define ADAPTIVE_MAX_PASSES 4  // refinements of cells whose centers deviate
+
+// splits [0, count - 1] at the midpoints while exceeds(a, b, mid), returns the sorted interval ends
+template <typename Exceeds>
+static std::vector<int> subdivide(int count, Exceeds exceeds)
+{
+    std::vector<int> result = {0};
+    std::vector<std::pair<int, int>> intervals; // stack, the leftmost interval on top
+    int cells = std::min(ADAPTIVE_MIN_CELLS, count - 1);
+    for (int c = cells - 1; c >= 0; c--)
+    {
+        intervals.push_back({(count - 1) * c / cells, (count - 1) * (c + 1) / cells});
+    }
+    while (!intervals.empty())
+    {
+        auto [a, b] = intervals.back();
+        intervals.pop_back();
+        int mid = (a + b) / 2;
+        if (b - a > 1 && exceeds(a, b, mid))
+        {
+            intervals.push_back({mid, b});
+            intervals.push_back({a, mid});
+            continue;
+        }
+        result.push_back(b);
+    }
+    return result;
+}
+
+void CPUImageMapper::tessellate(int render_size, float tolerance, int width, int height, MappingTables &mapping_tables, float arc_length, float interpolation_factor, float radius_modifier,
+                                float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right)
+{
+    ImageKernelParams params = {width, height, arc_length, interpolation_factor, radius_modifier, tilt,
+                                image_rotation, vertical_shift, crop_bottom, crop_top, crop_left, crop_right,
+                                mapping_tables._if_curve_integrals, mapping_tables._x_a_x, mapping_tables._a_x_y, mapping_tables._linear_fit,
+                                _image, _image_width, _image_height};
+
+    std::vector<WarpRow> rows;
+    float min_x, max_x, min_y, max_y;
+    setupWarpRows(params, rows, min_x, max_x, min_y, max_y);
+
+    // output pixels per unit, the long side of the image is render_size
+    float scale = render_size / std::max(max_x - min_x, max_y - min_y);
+
+    auto mapVertex = [&](int xi, int yi, float &x, float &y)
+    {
+        getWarpPoint(params, rows[yi], getArcOffset(params, rows[yi], xi), x, y);
+    };
+    // true if the mapped (xi, yi) is further than the tolerance from the interpolated (x, y)
+    auto deviates = [&](int xi, int yi, float x, float y)
+    {
+        float mx, my;
+        mapVertex(xi, yi, mx, my);
+        return std::hypot(mx - x, my - y) * scale > tolerance;
+    };
+    // midpoint m of the straight edge between columns (or rows) a and b
+    auto edgeDeviates = [&](int a_xi, int a_yi, int b_xi, int b_yi, int m_xi, int m_yi, float f)
+    {
+        float x0, y0, x1, y1;
+        mapVertex(a_xi, a_yi, x0, y0);
+        mapVertex(b_xi, b_yi, x1, y1);
+        return deviates(m_xi, m_yi, x0 + (x1 - x0) * f, y0 + (y1 - y0) * f);
+    };
+
+    std::vector<int> probe_rows;
+    for (int p = 0; p < ADAPTIVE_PROBE_ROWS; p++)
+    {
+        probe_rows.push_back((height - 1) * p / (ADAPTIVE_PROBE_ROWS - 1));
+    }
+    std::vector<int> columns = subdivide(width, [&](int a, int b, int mid)
+                                         {
+        float f = float(mid - a) / (b - a);
+        for (int yi : probe_rows)
+        {
+            if (edgeDeviates(a, yi, b, yi, mid, yi, f))
+                return true;
+        }
+        return false; });
+    std::vector<int> mesh_rows = subdivide(height, [&](int a, int b, int mid)
+                                           {
+        float f = float(mid - a) / (b - a);
+        for (int xi : columns)
+        {
+            if (edgeDeviates(xi, a, xi, b, xi, mid, f))
+                return true;
+        }
+        return false; });
+
+    auto mapMesh = [&]()
+    {
+        _mesh._width = int(columns.size());
+        _mesh._height = int(mesh_rows.size());
+        _mesh._x.resize(size_t(_mesh._width) * _mesh._height);
+        _mesh._y.resize(size_t(_mesh._width) * _mesh._height);
+        ThreadPool &pool = ThreadPool::shared();
+        pool.parallelFor(0, _mesh._height, pool.size() * ROW_BANDS_PER_THREAD, [&](int, int row_begin, int row_end)
+                         {
+            for (int j = row_begin; j < row_end; j++)
+            {
+                for (int k = 0; k < _mesh._width; k++)
+                {
+                    size_t index = size_t(j) * _mesh._width + k;
+                    mapVertex(columns[k], mesh_rows[j], _mesh._x[index], _mesh._y[index]);
+                }
+            } });
+    };
+
+    // the edges are tested, the cell centers can still bend away from the two triangles of a cell
+    for (int pass = 0; pass < ADAPTIVE_MAX_PASSES; pass++)
+    {
+        mapMesh();
+        std::vector<int> add_columns, add_rows;
+        for (int j = 0; j < _mesh._height - 1; j++)
+        {
+            for (int k = 0; k < _mesh._width - 1; k++)
+            {
+                int a = columns[k], b = columns[k + 1], c = mesh_rows[j], d = mesh_rows[j + 1];
+                if (b - a < 2 && d - c < 2)
+                    continue;
+                int m = (a + b) / 2, n = (c + d) / 2;
+                float f = float(m - a) / (b - a), g = float(n - c) / (d - c);
+
+                // the triangles of the cell as in getGridTriangles: (a, c) (b, c) (a, d) and (b, c) (b, d) (a, d)
+                size_t i00 = size_t(j) * _mesh._width + k, i10 = i00 + 1, i01 = i00 + _mesh._width, i11 = i01 + 1;
+                float x, y;
+                if (f + g <= 1)
+                {
+                    x = _mesh._x[i00] + f * (_mesh._x[i10] - _mesh._x[i00]) + g * (_mesh._x[i01] - _mesh._x[i00]);
+                    y = _mesh._y[i00] + f * (_mesh._y[i10] - _mesh._y[i00]) + g * (_mesh._y[i01] - _mesh._y[i00]);
+                }
+                else
+                {
+                    x = _mesh._x[i11] + (1 - f) * (_mesh._x[i01] - _mesh._x[i11]) + (1 - g) * (_mesh._x[i10] - _mesh._x[i11]);
+                    y = _mesh._y[i11] + (1 - f) * (_mesh._y[i01] - _mesh._y[i11]) + (1 - g) * (_mesh._y[i10] - _mesh._y[i11]);
+                }
+                if (!deviates(m, n, x, y))
+                    continue;
+                if (b - a >= 2)
+                    add_columns.push_back(m);
+                if (d - c >= 2)
+                    add_rows.push_back(n);
+            }
+        }
+        if (add_columns.empty() && add_rows.empty())
+            break;
+
+        columns.insert(columns.end(), add_columns.begin(), add_columns.end());
+        std::sort(columns.begin(), columns.end());
+        columns.erase(std::unique(columns.begin(), columns.end()), columns.end());
+        mesh_rows.insert(mesh_rows.end(), add_rows.begin(), add_rows.end());
+        std::sort(mesh_rows.begin(), mesh_rows.end());
+        mesh_rows.erase(std::unique(mesh_rows.begin(), mesh_rows.end()), mesh_rows.end());
+        if (pass == ADAPTIVE_MAX_PASSES - 1)
+            mapMesh();
+    }
+
+    _mesh._columns = columns;
+    _mesh._rows = mesh_rows;
+    _mesh._u.resize(_mesh._width);
+    _mesh._v.resize(_mesh._height);
+    for (int k = 0; k < _mesh._width; k++)
+    {
+        _mesh._u[k] = getImageTexX(params, float(columns[k]));
+    }
+    for (int j = 0; j < _mesh._height; j++)
+    {
+        _mesh._v[j] = getImageTexY(params, float(mesh_rows[j]));
+    }
+    _mesh._t = getGridTriangles(_mesh._width, _mesh._height);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "util.hpp"
+#include "gl_image_mapper.hpp"
+#include "thread_pool.hpp"
+#include "cpu_image_kernel.hpp"
+#include "cpu_renderer.hpp"
+
+//********************************/
+// Warp rows
+
+// semicircle of one mapping row
+struct WarpRow
+{
+    float r_orig, r_fit;
+    float radius, cp;
+    float arc_begin, arc_end; // arc offsets of the first and the last column
+    float min_y, max_y;       // mapped y range of the row
+};
+
+// arc offset of column xi on a row (image_map.comp: arc_offset), increasing in xi
+float getArcOffset(const ImageKernelParams &params, const WarpRow &row, int xi);
+
+// mapped point at an arc offset of a row
+void getWarpPoint(const ImageKernelParams &params, const WarpRow &row, float arc_offset, float &x, float &y);
+
+// rows and the bounds of the mapped mesh: x is extremal at the first or last column,
+// y at the first or last column or at the center of the semicircle
+void setupWarpRows(const ImageKernelParams &params, std::vector<WarpRow> &rows, float &min_x, float &max_x, float &min_y, float &max_y);
+
+//********************************/
+// AdaptiveMesh implementation
+
+// mesh of CPUImageMapper::tessellate: a subset of the columns and rows of the mapping, with
+// the grid topology and texture coordinates per column and row
+class AdaptiveMesh
+{
+public:
+    RenderData getRenderData()
+    {
+        return {_x.data(), _y.data(), nullptr, _t->data()};
+    }
+
+    GridTexCoords getTexCoords()
+    {
+        return {_u.data(), _v.data()};
+    }
+
+    int _width = 0, _height = 0;         // selected columns and rows
+    std::vector<int> _columns, _rows;    // their indices in the full mapping
+    std::vector<float> _x, _y;           // mapped vertices (_width x _height)
+    std::vector<float> _u, _v;           // texture coordinates per column and per row
+    std::shared_ptr<const std::vector<unsigned int>> _t;
+};
+
+//********************************/
+// CPUImageMapper implementation
+
+// ImageMapper without a GL context: computes the same positions, colours and triangles as
+// image_map.comp into an ImageMapResult. Rows are mapped in parallel, every row is vectorized
+// with the image kernel if the cpu supports it.
+class CPUImageMapper
+{
+public:
+    CPUImageMapper() = default;
+
+    ~CPUImageMapper();
+
+    int _width = 0, _height = 0, _size = 0;
+    ImageMapResult *_result = nullptr;
+    bool _vectorized = true;
+
+    void setSize(int width, int height);
+
+    // the image is not copied and has to outlive the mapper
+    void loadImage(int width, int height, const unsigned char *image);
+
+    void map(int width, int height, MappingTables &mapping_tables, float arc_length, float interpolation_factor, float radius_modifier,
+             float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right);
+
+    // backward warp: renders the unrolled image into the renderer without building a mesh.
+    // every output pixel is traced back to a fractional (row, column) of the width x height
+    // mapping and the image is sampled there. same bounds and orientation as rendering the mesh
+    RenderResult warp(CPURenderer &renderer, int render_size, int width, int height, MappingTables &mapping_tables, float arc_length, float interpolation_factor, float radius_modifier,
+                      float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right);
+
+    // backward warp in bands of band_height output rows for images that do not fit into memory:
+    // consume(band, first row, image height) gets the RGBA bands from top to bottom and returns
+    // false to stop. returns the size of the whole image (without pixels)
+    RenderResult warpBands(int render_size, int band_height, int width, int height, MappingTables &mapping_tables, float arc_length, float interpolation_factor, float radius_modifier,
+                           float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right,
+                           const std::function<bool(const RenderResult &, int, int)> &consume);
+
+    // adaptive mesh of the width x height mapping into _mesh: columns and rows are only kept where
+    // the triangles would otherwise deviate more than tolerance pixels (at render_size) from the mapping
+    void tessellate(int render_size, float tolerance, int width, int height, MappingTables &mapping_tables, float arc_length, float interpolation_factor, float radius_modifier,
+                    float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right);
+
+    AdaptiveMesh _mesh;
+
+private:
+    // scalar reference of imageKernelVectorRow
+    void mapRow(const ImageKernelParams &params, int yi);
+
+
+    const unsigned char *_image = nullptr;
+    int _image_width = 0, _image_height = 0;
+};
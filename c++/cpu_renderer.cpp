@@ -0,0 +1,422 @@
+#include "cpu_renderer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//********************************/
+// CPURenderer implementation
+
+void sampleTexture(const unsigned char *image, int image_width, int image_height, float s, float t, float *rgb)
+{
+    float iw = float(image_width), ih = float(image_height);
+
+    float u = s * iw - 0.5f;
+    float v = t * ih - 0.5f;
+    u -= iw * std::floor(u / iw);
+    v -= ih * std::floor(v / ih);
+    float u0 = std::min(std::floor(u), iw - 1.f);
+    float v0 = std::min(std::floor(v), ih - 1.f);
+    float fu = u - u0, fv = v - v0;
+
+    int i0 = int(u0), j0 = int(v0);
+    int i1 = i0 + 1 == image_width ? 0 : i0 + 1;
+    int j1 = j0 + 1 == image_height ? 0 : j0 + 1;
+
+    const unsigned char *row0 = image + size_t(j0) * image_width * 4;
+    const unsigned char *row1 = image + size_t(j1) * image_width * 4;
+    float filtered[4];
+    for (int ch = 0; ch < 4; ch++)
+    {
+        float top = row0[i0 * 4 + ch] * (1.f - fu) + row0[i1 * 4 + ch] * fu;
+        float bottom = row1[i0 * 4 + ch] * (1.f - fu) + row1[i1 * 4 + ch] * fu;
+        filtered[ch] = top * (1.f - fv) + bottom * fv;
+    }
+
+    // pixel.a < 1.0 after the conversion to 8 bit
+    bool opaque = filtered[3] >= 254.5f;
+    for (int ch = 0; ch < 3; ch++)
+    {
+        rgb[ch] = opaque ? filtered[ch] * (1.f / 255.f) : 1.f;
+    }
+}
+
+void CPURenderer::setSize(int width, int height)
+{
+    if (width == _width && height == _height)
+        return;
+
+    _width = width;
+    _height = height;
+    _size = width * height;
+}
+
+void CPURenderer::getRenderSize(int render_size, float hw_retio, int &render_width, int &render_height)
+{
+    // short size is always render_size
+    render_width = render_size;
+    render_height = render_size;
+    if (hw_retio > 1)
+    {
+        render_width = int(render_size / hw_retio);
+    }
+    else
+    {
+        render_height = int(render_size * hw_retio);
+    }
+}
+
+void CPURenderer::setRenderSize(int render_size, float hw_retio)
+{
+    int render_width, render_height;
+    getRenderSize(render_size, hw_retio, render_width, render_height);
+
+    if (render_width == _render_width && render_height == _render_height)
+        return;
+
+    _render_width = render_width;
+    _render_height = render_height;
+    _output_buffer.resize(_render_width * render_height * 4);
+
+    _tiles_x = (_render_width + CPU_RENDER_TILE_SIZE - 1) / CPU_RENDER_TILE_SIZE;
+    _tiles_y = (_render_height + CPU_RENDER_TILE_SIZE - 1) / CPU_RENDER_TILE_SIZE;
+}
+
+void CPURenderer::transformVertices(RenderData render_data, int num_points)
+{
+    _v_x.resize(num_points);
+    _v_y.resize(num_points);
+    _v_c.resize(render_data._c ? size_t(num_points) * 3 : 0);
+
+    // same mapping as the clip coordinates of Renderer followed by the viewport transform
+    float scale_x = _render_width / (_c_max_x - _c_min_x);
+    float scale_y = _render_height / (_c_max_y - _c_min_y);
+    ThreadPool::shared().parallelFor(0, num_points, ThreadPool::shared().size(), [&](int, int begin, int end)
+                                     {
+        for (int i = begin; i < end; i++)
+        {
+            _v_x[i] = (render_data._x[i] - _c_min_x) * scale_x;
+            _v_y[i] = _render_height - (render_data._y[i] - _c_min_y) * scale_y;
+        }
+        if (render_data._c)
+        {
+            std::copy(render_data._c + size_t(begin) * 3, render_data._c + size_t(end) * 3, _v_c.begin() + size_t(begin) * 3);
+        } });
+}
+
+void CPURenderer::binPrimitives(const unsigned int *indices, int num_primitives, int vertices_per_primitive, float expand)
+{
+    int num_tiles = _tiles_x * _tiles_y;
+    int num_chunks = ThreadPool::shared().size() * 4;
+    _bins.resize(num_chunks);
+
+    ThreadPool::shared().parallelFor(0, num_primitives, num_chunks, [&](int chunk, int begin, int end)
+                                     {
+        std::vector<std::vector<unsigned int>> &bins = _bins[chunk];
+        bins.resize(num_tiles);
+        for (std::vector<unsigned int> &bin : bins)
+        {
+            bin.clear();
+        }
+
+        for (int p = begin; p < end; p++)
+        {
+            const unsigned int *v = indices + size_t(p) * vertices_per_primitive;
+            float min_x = _v_x[v[0]], max_x = min_x;
+            float min_y = _v_y[v[0]], max_y = min_y;
+            for (int k = 1; k < vertices_per_primitive; k++)
+            {
+                min_x = std::min(min_x, _v_x[v[k]]);
+                max_x = std::max(max_x, _v_x[v[k]]);
+                min_y = std::min(min_y, _v_y[v[k]]);
+                max_y = std::max(max_y, _v_y[v[k]]);
+            }
+
+            // pixels whose centers lie inside the bounding box
+            int px_begin = std::max(0, int(std::ceil(min_x - expand - 0.5f)));
+            int px_end = std::min(_render_width - 1, int(std::floor(max_x + expand - 0.5f)));
+            int py_begin = std::max(0, int(std::ceil(min_y - expand - 0.5f)));
+            int py_end = std::min(_render_height - 1, int(std::floor(max_y + expand - 0.5f)));
+            if (px_begin > px_end || py_begin > py_end)
+                continue; // covers no pixel center (most triangles of a dense mesh)
+
+            for (int ty = py_begin / CPU_RENDER_TILE_SIZE; ty <= py_end / CPU_RENDER_TILE_SIZE; ty++)
+            {
+                for (int tx = px_begin / CPU_RENDER_TILE_SIZE; tx <= px_end / CPU_RENDER_TILE_SIZE; tx++)
+                {
+                    bins[ty * _tiles_x + tx].push_back(p);
+                }
+            }
+        } });
+
+    for (int chunk = std::min(num_chunks, num_primitives); chunk < num_chunks; chunk++)
+    {
+        // chunks that got no primitives (parallelFor never calls them)
+        _bins[chunk].assign(num_tiles, std::vector<unsigned int>());
+    }
+}
+
+void CPURenderer::clear()
+{
+    // glClearColor(1.0, 1.0, 1.0, 0.0)
+    for (size_t i = 0; i < _output_buffer.size(); i += 4)
+    {
+        _output_buffer[i] = 255;
+        _output_buffer[i + 1] = 255;
+        _output_buffer[i + 2] = 255;
+        _output_buffer[i + 3] = 0;
+    }
+}
+
+static inline unsigned char toUnorm8(float value)
+{
+    return (unsigned char)(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+// edge function, positive if p lies to the left of a -> b
+static inline float edge(float ax, float ay, float bx, float by, float px, float py)
+{
+    return (bx - ax) * (py - ay) - (by - ay) * (px - ax);
+}
+
+// fill rule for pixel centers exactly on an edge: of two triangles sharing the edge exactly one owns it
+static inline bool ownsEdge(float ax, float ay, float bx, float by)
+{
+    return ay == by ? bx < ax : by > ay;
+}
+
+void CPURenderer::rasterizeTriangles(int tile, const unsigned int *indices)
+{
+    int tile_x0 = (tile % _tiles_x) * CPU_RENDER_TILE_SIZE;
+    int tile_y0 = (tile / _tiles_x) * CPU_RENDER_TILE_SIZE;
+    int tile_x1 = std::min(tile_x0 + CPU_RENDER_TILE_SIZE, _render_width) - 1;
+    int tile_y1 = std::min(tile_y0 + CPU_RENDER_TILE_SIZE, _render_height) - 1;
+
+    for (const std::vector<std::vector<unsigned int>> &chunk_bins : _bins)
+    {
+        for (unsigned int p : chunk_bins[tile])
+        {
+            unsigned int i0 = indices[size_t(p) * 3], i1 = indices[size_t(p) * 3 + 1], i2 = indices[size_t(p) * 3 + 2];
+            float area = edge(_v_x[i0], _v_y[i0], _v_x[i1], _v_y[i1], _v_x[i2], _v_y[i2]);
+            if (area == 0)
+                continue;
+            if (area < 0)
+            {
+                // no culling: both windings are drawn
+                std::swap(i1, i2);
+                area = -area;
+            }
+            float x0 = _v_x[i0], y0 = _v_y[i0];
+            float x1 = _v_x[i1], y1 = _v_y[i1];
+            float x2 = _v_x[i2], y2 = _v_y[i2];
+
+            int px_begin = std::max(tile_x0, int(std::ceil(std::min({x0, x1, x2}) - 0.5f)));
+            int px_end = std::min(tile_x1, int(std::floor(std::max({x0, x1, x2}) - 0.5f)));
+            int py_begin = std::max(tile_y0, int(std::ceil(std::min({y0, y1, y2}) - 0.5f)));
+            int py_end = std::min(tile_y1, int(std::floor(std::max({y0, y1, y2}) - 0.5f)));
+
+            bool owns_0 = ownsEdge(x1, y1, x2, y2);
+            bool owns_1 = ownsEdge(x2, y2, x0, y0);
+            bool owns_2 = ownsEdge(x0, y0, x1, y1);
+
+            // Gouraud shading: colour = sum of the vertex colours weighted by the barycentric coordinates
+            // (textured: the texture coordinates are interpolated the same way and the image is sampled)
+            float inv_area = 1.f / area;
+            float values[3][3];
+            unsigned int vertices[3] = {i0, i1, i2};
+            for (int v = 0; v < 3; v++)
+            {
+                if (_texture)
+                {
+                    values[v][0] = _tex_coords.u[vertices[v] % _width];
+                    values[v][1] = _tex_coords.v[vertices[v] / _width];
+                    values[v][2] = 0.f;
+                }
+                else
+                {
+                    std::copy(&_v_c[size_t(vertices[v]) * 3], &_v_c[size_t(vertices[v]) * 3] + 3, values[v]);
+                }
+            }
+            const float *c0 = values[0], *c1 = values[1], *c2 = values[2];
+
+            for (int py = py_begin; py <= py_end; py++)
+            {
+                float cy = py + 0.5f;
+                unsigned char *out = &_output_buffer[(size_t(py) * _render_width + px_begin) * 4];
+                for (int px = px_begin; px <= px_end; px++, out += 4)
+                {
+                    float cx = px + 0.5f;
+                    float w0 = edge(x1, y1, x2, y2, cx, cy);
+                    float w1 = edge(x2, y2, x0, y0, cx, cy);
+                    float w2 = edge(x0, y0, x1, y1, cx, cy);
+                    if (w0 < 0 || w1 < 0 || w2 < 0)
+                        continue;
+                    if ((w0 == 0 && !owns_0) || (w1 == 0 && !owns_1) || (w2 == 0 && !owns_2))
+                        continue;
+
+                    w0 *= inv_area;
+                    w1 *= inv_area;
+                    w2 *= inv_area;
+                    float rgb[3] = {w0 * c0[0] + w1 * c1[0] + w2 * c2[0], w0 * c0[1] + w1 * c1[1] + w2 * c2[1], w0 * c0[2] + w1 * c1[2] + w2 * c2[2]};
+                    if (_texture)
+                    {
+                        sampleTexture(_texture, _texture_width, _texture_height, rgb[0], rgb[1], rgb);
+                    }
+                    out[0] = toUnorm8(rgb[0]);
+                    out[1] = toUnorm8(rgb[1]);
+                    out[2] = toUnorm8(rgb[2]);
+                    out[3] = 255;
+                }
+            }
+        }
+    }
+}
+
+void CPURenderer::rasterizeLines(int tile, const unsigned int *indices, int line_size)
+{
+    int tile_x0 = (tile % _tiles_x) * CPU_RENDER_TILE_SIZE;
+    int tile_y0 = (tile / _tiles_x) * CPU_RENDER_TILE_SIZE;
+    int tile_x1 = std::min(tile_x0 + CPU_RENDER_TILE_SIZE, _render_width) - 1;
+    int tile_y1 = std::min(tile_y0 + CPU_RENDER_TILE_SIZE, _render_height) - 1;
+    line_size = std::max(1, line_size);
+
+    for (const std::vector<std::vector<unsigned int>> &chunk_bins : _bins)
+    {
+        for (unsigned int p : chunk_bins[tile])
+        {
+            float x0 = _v_x[indices[size_t(p) * 2]], y0 = _v_y[indices[size_t(p) * 2]];
+            float x1 = _v_x[indices[size_t(p) * 2 + 1]], y1 = _v_y[indices[size_t(p) * 2 + 1]];
+
+            // aliased wide lines: one run of line_size pixels along the minor axis per major axis pixel
+            bool x_major = std::abs(x1 - x0) >= std::abs(y1 - y0);
+            float a0 = x_major ? x0 : y0, a1 = x_major ? x1 : y1; // major axis
+            float b0 = x_major ? y0 : x0, b1 = x_major ? y1 : x1; // minor axis
+            if (a0 == a1)
+                continue;
+            if (a0 > a1)
+            {
+                std::swap(a0, a1);
+                std::swap(b0, b1);
+            }
+            float slope = (b1 - b0) / (a1 - a0);
+
+            int major_begin = std::max(x_major ? tile_x0 : tile_y0, int(std::ceil(a0 - 0.5f)));
+            int major_end = std::min(x_major ? tile_x1 : tile_y1, int(std::ceil(a1 - 0.5f)) - 1); // last pixel center excluded
+            int minor_min = x_major ? tile_y0 : tile_x0;
+            int minor_max = x_major ? tile_y1 : tile_x1;
+
+            for (int a = major_begin; a <= major_end; a++)
+            {
+                float b = b0 + (a + 0.5f - a0) * slope;
+                int run_begin = int(std::floor(b - 0.5f * line_size + 0.5f));
+                for (int m = std::max(run_begin, minor_min); m <= std::min(run_begin + line_size - 1, minor_max); m++)
+                {
+                    int px = x_major ? a : m;
+                    int py = x_major ? m : a;
+                    unsigned char *out = &_output_buffer[(size_t(py) * _render_width + px) * 4];
+                    out[0] = 0;
+                    out[1] = 0;
+                    out[2] = 0;
+                    out[3] = 255;
+                }
+            }
+        }
+    }
+}
+
+RenderResult CPURenderer::renderTriangles(int width, int height, int render_size, RenderData render_data)
+{
+    _texture = nullptr;
+    return drawTriangles(width, height, render_size, render_data);
+}
+
+RenderResult CPURenderer::renderTexturedTriangles(int width, int height, int render_size, RenderData render_data, GridTexCoords tex_coords,
+                                                  const unsigned char *image, int image_width, int image_height)
+{
+    _texture = image;
+    _texture_width = image_width;
+    _texture_height = image_height;
+    _tex_coords = tex_coords;
+    render_data._c = nullptr; // the colours are not copied
+    RenderResult result = drawTriangles(width, height, render_size, render_data);
+    _texture = nullptr;
+    return result;
+}
+
+RenderResult CPURenderer::drawTriangles(int width, int height, int render_size, RenderData render_data)
+{
+    setSize(width, height);
+
+    _c_min_x = *std::min_element(render_data._x, render_data._x + _size);
+    _c_max_x = *std::max_element(render_data._x, render_data._x + _size);
+    _c_min_y = *std::min_element(render_data._y, render_data._y + _size);
+    _c_max_y = *std::max_element(render_data._y, render_data._y + _size);
+
+    float ratio = std::abs(_c_max_y - _c_min_y) / std::abs(_c_max_x - _c_min_x);
+
+    setRenderSize(render_size, ratio);
+
+    transformVertices(render_data, _size);
+
+    int num_triangles = (_width - 1) * (_height - 1) * 2;
+    binPrimitives(render_data._t, num_triangles, 3, 0.f);
+
+    clear();
+    ThreadPool::shared().parallelFor(0, _tiles_x * _tiles_y, _tiles_x * _tiles_y, [&](int, int begin, int end)
+                                     {
+        for (int tile = begin; tile < end; tile++)
+        {
+            rasterizeTriangles(tile, render_data._t);
+        } });
+
+    return {_output_buffer.data(), (size_t)_render_width, (size_t)_render_height};
+}
+
+RenderResult CPURenderer::beginImage(float min_x, float max_x, float min_y, float max_y, int render_size)
+{
+    _c_min_x = min_x;
+    _c_max_x = max_x;
+    _c_min_y = min_y;
+    _c_max_y = max_y;
+
+    float ratio = std::abs(_c_max_y - _c_min_y) / std::abs(_c_max_x - _c_min_x);
+
+    setRenderSize(render_size, ratio);
+
+    clear();
+
+    return {_output_buffer.data(), (size_t)_render_width, (size_t)_render_height};
+}
+
+RenderResult CPURenderer::renderLines(int width, int height, int num_points, int num_indices, int render_size, bool render_on_top, int line_size, RenderData render_data)
+{
+    setSize(width, height);
+
+    if (!render_on_top)
+    {
+        _c_min_x = *std::min_element(render_data._x, render_data._x + num_points);
+        _c_max_x = *std::max_element(render_data._x, render_data._x + num_points);
+        _c_min_y = *std::min_element(render_data._y, render_data._y + num_points);
+        _c_max_y = *std::max_element(render_data._y, render_data._y + num_points);
+
+        float ratio = std::abs(_c_max_y - _c_min_y) / std::abs(_c_max_x - _c_min_x);
+
+        setRenderSize(render_size, ratio);
+    }
+
+    transformVertices(render_data, num_points);
+
+    binPrimitives(render_data._t, num_indices / 2, 2, 0.5f * std::max(1, line_size) + 1.f);
+
+    if (!render_on_top)
+    {
+        clear();
+    }
+    ThreadPool::shared().parallelFor(0, _tiles_x * _tiles_y, _tiles_x * _tiles_y, [&](int, int begin, int end)
+                                     {
+        for (int tile = begin; tile < end; tile++)
+        {
+            rasterizeLines(tile, render_data._t, line_size);
+        } });
+
+    return {_output_buffer.data(), (size_t)_render_width, (size_t)_render_height};
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "util.hpp"
+#include "gl_renderer.hpp"
+#include "thread_pool.hpp"
+
+//********************************/
+// CPURenderer implementation
+
+// Software rasterizer with the same output as Renderer, without a GL context.
+// Primitives are binned into screen tiles and the tiles are rasterized in parallel; every tile
+// draws its primitives in submission order, so overlapping primitives resolve like in GL.
+// The image has the orientation of glReadPixels (first row at the bottom of the viewport).
+
+#define CPU_RENDER_TILE_SIZE 64
+
+// GL_LINEAR + GL_REPEAT sample of an RGBA image at (s, t), texels that are not fully opaque turn white
+void sampleTexture(const unsigned char *image, int image_width, int image_height, float s, float t, float *rgb);
+
+class CPURenderer
+{
+public:
+    CPURenderer() = default;
+
+    int _width = 0, _height = 0, _size = 0;
+    int _render_width = 0, _render_height = 0;
+    std::vector<unsigned char> _output_buffer;
+    float _c_min_x, _c_max_x;
+    float _c_min_y, _c_max_y;
+
+    void setSize(int width, int height);
+
+    void setRenderSize(int render_size, float hw_retio);
+
+    // image size of setRenderSize
+    static void getRenderSize(int render_size, float hw_retio, int &render_width, int &render_height);
+
+    RenderResult renderTriangles(int width, int height, int render_size, RenderData render_data);
+
+    // triangles of a width x height grid, coloured from the image at the interpolated texture
+    // coordinates of the vertices instead of the vertex colours (render_data._c is not used)
+    RenderResult renderTexturedTriangles(int width, int height, int render_size, RenderData render_data, GridTexCoords tex_coords,
+                                         const unsigned char *image, int image_width, int image_height);
+
+    RenderResult renderLines(int width, int height, int num_points, int num_indices, int render_size, bool render_on_top, int line_size, RenderData render_data);
+
+    // sets the bounds and the render size like renderTriangles and clears the image,
+    // for callers that write _output_buffer themselves (lines can be rendered on top)
+    RenderResult beginImage(float min_x, float max_x, float min_y, float max_y, int render_size);
+
+private:
+    // viewport coordinates (pixel centers at +0.5) and colours of the vertices
+    void transformVertices(RenderData render_data, int num_points);
+
+    // sorts the primitives into the tiles they may cover, expand: extra margin in pixels
+    void binPrimitives(const unsigned int *indices, int num_primitives, int vertices_per_primitive, float expand);
+
+    void clear();
+
+    void rasterizeTriangles(int tile, const unsigned int *indices);
+
+    // shared by both triangle renders, _texture selects the colours
+    RenderResult drawTriangles(int width, int height, int render_size, RenderData render_data);
+
+    void rasterizeLines(int tile, const unsigned int *indices, int line_size);
+
+    std::vector<float> _v_x, _v_y;
+    std::vector<float> _v_c; // 3 per vertex, empty for lines (black)
+    int _tiles_x = 0, _tiles_y = 0;
+    std::vector<std::vector<std::vector<unsigned int>>> _bins; // [binning chunk][tile] -> primitives
+
+    // texture of renderTexturedTriangles, nullptr for vertex colours
+    const unsigned char *_texture = nullptr;
+    int _texture_width = 0, _texture_height = 0;
+    GridTexCoords _tex_coords;
+};
@@ -0,0 +1,123 @@
+#include "cubic_spline.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+//********************************/
+// CubicSpline implementation
+
+void CubicSpline::set(const alglib::spline1dinterpolant &spline)
+{
+    alglib::ae_int_t n;
+    alglib::real_2d_array table;
+    alglib::spline1dunpack(spline, n, table);
+    assert(n >= 2 && "Called set with an empty spline");
+
+    int intervals = int(n) - 1;
+    _knots.resize(n);
+    _c0.resize(intervals);
+    _c1.resize(intervals);
+    _c2.resize(intervals);
+    _c3.resize(intervals);
+    _integrals.resize(n);
+    _integrals[0] = 0;
+    for (int i = 0; i < intervals; i++)
+    {
+        _knots[i] = table[i][0];
+        _c0[i] = table[i][2];
+        _c1[i] = table[i][3];
+        _c2[i] = table[i][4];
+        _c3[i] = table[i][5];
+
+        double t = table[i][1] - table[i][0];
+        _integrals[i + 1] = _integrals[i] + t * (_c0[i] + t * (_c1[i] / 2 + t * (_c2[i] / 3 + t * _c3[i] / 4)));
+    }
+    _knots[intervals] = table[intervals - 1][1];
+}
+
+int CubicSpline::findInterval(double x, int &cursor) const
+{
+    int last = int(_c0.size()) - 1;
+    if (x >= _knots[cursor] && (cursor == last || x < _knots[cursor + 1]))
+        return cursor;
+
+    if (x >= _knots[cursor])
+    {
+        // ascending queries usually only move to one of the next intervals
+        int next = cursor + 1;
+        while (next < last && x >= _knots[next + 1] && next - cursor < 4)
+            next++;
+        if (next == last || x < _knots[next + 1])
+        {
+            cursor = next;
+            return cursor;
+        }
+    }
+
+    cursor = int(std::upper_bound(_knots.begin() + 1, _knots.begin() + last + 1, x) - _knots.begin()) - 1;
+    return cursor;
+}
+
+double CubicSpline::operator()(double x) const
+{
+    int cursor = 0;
+    int i = findInterval(x, cursor);
+    double t = x - _knots[i];
+    return _c0[i] + t * (_c1[i] + t * (_c2[i] + t * _c3[i]));
+}
+
+void CubicSpline::diff(double x, double &value, double &derivative) const
+{
+    int cursor = 0;
+    int i = findInterval(x, cursor);
+    double t = x - _knots[i];
+    value = _c0[i] + t * (_c1[i] + t * (_c2[i] + t * _c3[i]));
+    derivative = _c1[i] + t * (2 * _c2[i] + t * 3 * _c3[i]);
+}
+
+double CubicSpline::integrate(double x) const
+{
+    int cursor = 0;
+    int i = findInterval(x, cursor);
+    double t = x - _knots[i];
+    return _integrals[i] + t * (_c0[i] + t * (_c1[i] / 2 + t * (_c2[i] / 3 + t * _c3[i] / 4)));
+}
+
+void CubicSpline::evaluate(const float *x, int count, float *out, float *derivative) const
+{
+    const double *knots = _knots.data();
+    const double *c0 = _c0.data(), *c1 = _c1.data(), *c2 = _c2.data(), *c3 = _c3.data();
+
+    int cursor = 0;
+    int intervals[CUBIC_SPLINE_BATCH];
+    for (int begin = 0; begin < count; begin += CUBIC_SPLINE_BATCH)
+    {
+        int size = std::min(CUBIC_SPLINE_BATCH, count - begin);
+        const float *batch_x = x + begin;
+
+        // the search is sequential, the polynomials below are branch free
+        for (int k = 0; k < size; k++)
+        {
+            intervals[k] = findInterval(batch_x[k], cursor);
+        }
+
+        if (derivative != nullptr)
+        {
+            float *batch_derivative = derivative + begin;
+            for (int k = 0; k < size; k++)
+            {
+                int i = intervals[k];
+                double t = batch_x[k] - knots[i];
+                batch_derivative[k] = float(c1[i] + t * (2 * c2[i] + t * 3 * c3[i]));
+            }
+        }
+
+        float *batch_out = out + begin;
+        for (int k = 0; k < size; k++)
+        {
+            int i = intervals[k];
+            double t = batch_x[k] - knots[i];
+            batch_out[k] = float(c0[i] + t * (c1[i] + t * (c2[i] + t * c3[i])));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "alglib-cpp/src/interpolation.h"
+
+//********************************/
+// CubicSpline implementation
+
+// Piecewise cubic polynomials of an alglib spline, with the coefficients of all intervals in
+// contiguous arrays (one per power). A single value searches its interval. The batched evaluations
+// move a cursor over the intervals instead, so tables over ascending positions cost one
+// pass over the queries and the knots. Outside of the knots the first and the last polynomial are
+// extrapolated (like alglib::spline1dcalc).
+
+#define CUBIC_SPLINE_BATCH 256 // queries whose intervals are found before the polynomials are evaluated
+
+class CubicSpline
+{
+public:
+    CubicSpline() = default;
+
+    // takes over the polynomials of spline (alglib::spline1dunpack)
+    void set(const alglib::spline1dinterpolant &spline);
+
+    double operator()(double x) const;
+
+    // value and first derivative
+    void diff(double x, double &value, double &derivative) const;
+
+    // antiderivative, zero at the first knot
+    double integrate(double x) const;
+
+    // out[i] = spline(x[i]) (and derivative[i] the first derivative if not nullptr),
+    // fastest for ascending x. out may be x
+    void evaluate(const float *x, int count, float *out, float *derivative = nullptr) const;
+
+private:
+    // interval of x, the cursor interval is tried first and updated
+    int findInterval(double x, int &cursor) const;
+
+    std::vector<double> _knots;              // n knots
+    std::vector<double> _c0, _c1, _c2, _c3;  // n - 1 intervals, p(t) = c0 + c1 t + c2 t^2 + c3 t^3 with t = x - knot
+    std::vector<double> _integrals;          // antiderivative at the knots
+};
\ No newline at end of file
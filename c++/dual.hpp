@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cmath>
+
+//********************************/
+// Forward mode dual numbers
+//
+// A Dual carries a value and its partial derivatives with respect to up to DUAL_MAX_PARAMS
+// parameters. Evaluating templated math with Dual instead of double yields the value and the
+// gradient in the same pass. Comparisons only look at the value.
+
+#define DUAL_MAX_PARAMS 3
+
+struct Dual
+{
+    double v;
+    double d[DUAL_MAX_PARAMS];
+
+    Dual(double value = 0) : v(value), d{0, 0, 0} {}
+
+    // the parameter with the given index (derivative 1 with respect to itself)
+    static Dual variable(double value, int index)
+    {
+        Dual result(value);
+        if (index >= 0)
+            result.d[index] = 1;
+        return result;
+    }
+
+    // value + derivative * direction for every partial derivative (chain rule for f(this))
+    Dual chain(double value, double derivative) const
+    {
+        Dual result(value);
+        for (int i = 0; i < DUAL_MAX_PARAMS; i++)
+            result.d[i] = d[i] * derivative;
+        return result;
+    }
+
+    Dual operator-() const
+    {
+        return chain(-v, -1);
+    }
+
+    Dual &operator+=(const Dual &other)
+    {
+        v += other.v;
+        for (int i = 0; i < DUAL_MAX_PARAMS; i++)
+            d[i] += other.d[i];
+        return *this;
+    }
+
+    Dual &operator-=(const Dual &other)
+    {
+        v -= other.v;
+        for (int i = 0; i < DUAL_MAX_PARAMS; i++)
+            d[i] -= other.d[i];
+        return *this;
+    }
+
+    Dual &operator*=(const Dual &other)
+    {
+        for (int i = 0; i < DUAL_MAX_PARAMS; i++)
+            d[i] = d[i] * other.v + v * other.d[i];
+        v *= other.v;
+        return *this;
+    }
+
+    Dual &operator/=(const Dual &other)
+    {
+        double inv = 1.0 / other.v;
+        v *= inv;
+        for (int i = 0; i < DUAL_MAX_PARAMS; i++)
+            d[i] = (d[i] - v * other.d[i]) * inv;
+        return *this;
+    }
+};
+
+inline Dual operator+(Dual a, const Dual &b) { return a += b; }
+inline Dual operator-(Dual a, const Dual &b) { return a -= b; }
+inline Dual operator*(Dual a, const Dual &b) { return a *= b; }
+inline Dual operator/(Dual a, const Dual &b) { return a /= b; }
+
+inline Dual operator+(Dual a, double b) { return a += Dual(b); }
+inline Dual operator-(Dual a, double b) { return a -= Dual(b); }
+inline Dual operator*(const Dual &a, double b) { return a.chain(a.v * b, b); }
+inline Dual operator/(const Dual &a, double b) { return a.chain(a.v / b, 1.0 / b); }
+
+inline Dual operator+(double a, const Dual &b) { return b + a; }
+inline Dual operator-(double a, const Dual &b) { return -b + a; }
+inline Dual operator*(double a, const Dual &b) { return b * a; }
+inline Dual operator/(double a, const Dual &b) { return Dual(a) / b; }
+
+inline bool operator<(const Dual &a, const Dual &b) { return a.v < b.v; }
+inline bool operator>(const Dual &a, const Dual &b) { return a.v > b.v; }
+inline bool operator<=(const Dual &a, const Dual &b) { return a.v <= b.v; }
+inline bool operator>=(const Dual &a, const Dual &b) { return a.v >= b.v; }
+inline bool operator==(const Dual &a, const Dual &b) { return a.v == b.v; }
+inline bool operator!=(const Dual &a, const Dual &b) { return a.v != b.v; }
+
+inline Dual sqrt(const Dual &a)
+{
+    double s = std::sqrt(a.v);
+    return a.chain(s, 0.5 / s);
+}
+
+inline Dual sin(const Dual &a)
+{
+    return a.chain(std::sin(a.v), std::cos(a.v));
+}
+
+inline Dual cos(const Dual &a)
+{
+    return a.chain(std::cos(a.v), -std::sin(a.v));
+}
+
+inline Dual acos(const Dual &a)
+{
+    return a.chain(std::acos(a.v), -1.0 / std::sqrt(1.0 - a.v * a.v));
+}
+
+inline Dual pow(const Dual &a, double p)
+{
+    return a.chain(std::pow(a.v, p), p * std::pow(a.v, p - 1));
+}
+
+inline Dual abs(const Dual &a)
+{
+    return a.v < 0 ? -a : a;
+}
+
+inline double value(double a)
+{
+    return a;
+}
+
+inline double value(const Dual &a)
+{
+    return a.v;
+}
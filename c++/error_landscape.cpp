@@ -0,0 +1,136 @@
+#include "error_landscape.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+//********************************/
+// ErrorLandscape implementation
+
+void ErrorLandscape::reset(const ErrorLandscapeKey &key, double rad_lower, double rad_upper)
+{
+    _valid = true;
+    _key = key;
+    _rad_sign = rad_lower < 0 ? -1 : 1;
+    _log_rad_lower = std::log(std::min(std::abs(rad_lower), std::abs(rad_upper)));
+    _log_rad_upper = std::log(std::max(std::abs(rad_lower), std::abs(rad_upper)));
+    _sums.assign(LANDSCAPE_IF_NODES * LANDSCAPE_D_NODES * LANDSCAPE_RAD_NODES, ErrorSums());
+    _filled.assign(LANDSCAPE_IF_NODES * LANDSCAPE_D_NODES, false);
+}
+
+bool ErrorLandscape::isComplete() const
+{
+    return _valid && std::all_of(_filled.begin(), _filled.end(), [](bool filled)
+                                 { return filled; });
+}
+
+double ErrorLandscape::getIF(int if_node) const
+{
+    return double(if_node) / (LANDSCAPE_IF_NODES - 1);
+}
+
+double ErrorLandscape::getD(int d_node) const
+{
+    return double(d_node) / (LANDSCAPE_D_NODES - 1);
+}
+
+double ErrorLandscape::getRad(int rad_node) const
+{
+    double t = double(rad_node) / (LANDSCAPE_RAD_NODES - 1);
+    return _rad_sign * std::exp(_log_rad_lower + t * (_log_rad_upper - _log_rad_lower));
+}
+
+bool ErrorLandscape::containsRad(double rad) const
+{
+    if (rad * _rad_sign <= 0)
+        return false;
+    double log_rad = std::log(std::abs(rad));
+    return log_rad >= _log_rad_lower && log_rad <= _log_rad_upper;
+}
+
+void ErrorLandscape::setSlab(int if_node, int d_node, const std::vector<ErrorSums> &sums)
+{
+    std::copy(sums.begin(), sums.end(), _sums.begin() + (if_node * LANDSCAPE_D_NODES + d_node) * LANDSCAPE_RAD_NODES);
+    _filled[if_node * LANDSCAPE_D_NODES + d_node] = true;
+}
+
+// lower node and weight of the upper node for t in [0, 1] on a lattice with n nodes
+static void getCell(double t, int n, int &node, double &weight)
+{
+    double position = std::clamp(t, 0.0, 1.0) * (n - 1);
+    node = std::min(int(position), n - 2);
+    weight = position - node;
+}
+
+double ErrorLandscape::interpolate(const LandscapePoint &point, float x_weight, float y_weight, float r_weight, float a_weight) const
+{
+    int i, j, k;
+    double wi, wj, wk;
+    getCell(point[0], LANDSCAPE_IF_NODES, i, wi);
+    getCell(point[1], LANDSCAPE_D_NODES, j, wj);
+    getCell((std::log(std::abs(point[2])) - _log_rad_lower) / (_log_rad_upper - _log_rad_lower), LANDSCAPE_RAD_NODES, k, wk);
+
+    double result = 0;
+    for (int c = 0; c < 8; c++)
+    {
+        int di = c & 1, dj = (c >> 1) & 1, dk = (c >> 2) & 1;
+        double weight = (di ? wi : 1 - wi) * (dj ? wj : 1 - wj) * (dk ? wk : 1 - wk);
+        if (weight == 0)
+            continue;
+        result += weight * getSums(i + di, j + dj, k + dk).weighted(x_weight, y_weight, r_weight, a_weight);
+    }
+    return result;
+}
+
+std::vector<LandscapePoint> ErrorLandscape::findMinima(int count, const bool optimized[3], const LandscapePoint &fixed, float x_weight, float y_weight, float r_weight, float a_weight) const
+{
+    // the interpolation is linear between the nodes, so the minimum over the optimized coordinates lies on a node
+    int n[3] = {optimized[0] ? LANDSCAPE_IF_NODES : 1, optimized[1] ? LANDSCAPE_D_NODES : 1, optimized[2] ? LANDSCAPE_RAD_NODES : 1};
+    std::vector<LandscapePoint> points;
+    std::vector<double> errors;
+    for (int i = 0; i < n[0]; i++)
+    {
+        for (int j = 0; j < n[1]; j++)
+        {
+            for (int k = 0; k < n[2]; k++)
+            {
+                LandscapePoint point = {optimized[0] ? getIF(i) : fixed[0], optimized[1] ? getD(j) : fixed[1], optimized[2] ? getRad(k) : fixed[2]};
+                points.push_back(point);
+                errors.push_back(interpolate(point, x_weight, y_weight, r_weight, a_weight));
+            }
+        }
+    }
+
+    // only local minima, neighbouring nodes of one basin would all polish to the same minimum
+    std::vector<int> minima;
+    for (int i = 0; i < n[0]; i++)
+    {
+        for (int j = 0; j < n[1]; j++)
+        {
+            for (int k = 0; k < n[2]; k++)
+            {
+                int index = (i * n[1] + j) * n[2] + k;
+                bool is_minimum = true;
+                for (int di = std::max(0, i - 1); di <= std::min(n[0] - 1, i + 1) && is_minimum; di++)
+                    for (int dj = std::max(0, j - 1); dj <= std::min(n[1] - 1, j + 1) && is_minimum; dj++)
+                        for (int dk = std::max(0, k - 1); dk <= std::min(n[2] - 1, k + 1) && is_minimum; dk++)
+                        {
+                            int neighbour = (di * n[1] + dj) * n[2] + dk;
+                            // ties go to the lower index
+                            is_minimum = errors[neighbour] > errors[index] || (errors[neighbour] == errors[index] && neighbour >= index);
+                        }
+                if (is_minimum)
+                    minima.push_back(index);
+            }
+        }
+    }
+
+    std::stable_sort(minima.begin(), minima.end(), [&](int a, int b)
+                     { return errors[a] < errors[b]; });
+
+    std::vector<LandscapePoint> result;
+    for (int m = 0; m < std::min(count, int(minima.size())); m++)
+    {
+        result.push_back(points[minima[m]]);
+    }
+    return result;
+}
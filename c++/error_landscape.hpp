@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "cpu_error_mapper.hpp"
+
+//********************************/
+// ErrorLandscape implementation
+//
+// Error sums of the optimization objective sampled on a lattice over the interpolation factor,
+// the d-factor and the radius factor (log scale). The error weights only combine the four sums,
+// so one lattice answers the optimization for every weight combination.
+
+#define LANDSCAPE_IF_NODES 11
+#define LANDSCAPE_D_NODES 11
+#define LANDSCAPE_RAD_NODES 16
+#define LANDSCAPE_DIMS 32 // error grid size of the samples
+
+// model properties the error sums depend on (besides the lattice coordinates)
+struct ErrorLandscapeKey
+{
+    float crop_top, crop_bottom, crop_left, crop_right;
+    float tilt, spline_smoothing, preview_image_scale;
+    bool enforce_isotropy, d_restrict, analytic;
+
+    bool operator==(const ErrorLandscapeKey &other) const
+    {
+        return crop_top == other.crop_top && crop_bottom == other.crop_bottom && crop_left == other.crop_left && crop_right == other.crop_right &&
+               tilt == other.tilt && spline_smoothing == other.spline_smoothing && preview_image_scale == other.preview_image_scale &&
+               enforce_isotropy == other.enforce_isotropy && d_restrict == other.d_restrict && analytic == other.analytic;
+    }
+};
+
+// lattice coordinates: interpolation factor, d-factor, radius factor
+typedef std::array<double, 3> LandscapePoint;
+
+class ErrorLandscape
+{
+public:
+    ErrorLandscape() = default;
+
+    // clears the lattice, the radius factor is sampled between rad_lower and rad_upper (same sign)
+    void reset(const ErrorLandscapeKey &key, double rad_lower, double rad_upper);
+
+    bool matches(const ErrorLandscapeKey &key) const
+    {
+        return _valid && _key == key;
+    }
+
+    bool isComplete() const;
+    bool isSlabFilled(int if_node, int d_node) const
+    {
+        return _filled[if_node * LANDSCAPE_D_NODES + d_node];
+    }
+
+    double getIF(int if_node) const;
+    double getD(int d_node) const;
+    double getRad(int rad_node) const;
+    bool containsRad(double rad) const;
+
+    // sums of all radius nodes of one (IF, d) node, normalized to one grid point
+    void setSlab(int if_node, int d_node, const std::vector<ErrorSums> &sums);
+
+    // trilinear interpolation of the weighted error (log scale in the radius factor)
+    double interpolate(const LandscapePoint &point, float x_weight, float y_weight, float r_weight, float a_weight) const;
+
+    // the count lowest lattice nodes of the weighted error, coordinates that are not optimized
+    // stay at their value in fixed (interpolated)
+    std::vector<LandscapePoint> findMinima(int count, const bool optimized[3], const LandscapePoint &fixed, float x_weight, float y_weight, float r_weight, float a_weight) const;
+
+private:
+    const ErrorSums &getSums(int if_node, int d_node, int rad_node) const
+    {
+        return _sums[(if_node * LANDSCAPE_D_NODES + d_node) * LANDSCAPE_RAD_NODES + rad_node];
+    }
+
+    bool _valid = false;
+    ErrorLandscapeKey _key;
+    double _rad_sign = 1;
+    double _log_rad_lower = 0, _log_rad_upper = 0;
+    std::vector<ErrorSums> _sums;
+    std::vector<char> _filled; // per (IF, d) slab, written concurrently by computeLandscape
+};
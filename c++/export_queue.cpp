@@ -0,0 +1,103 @@
+#include "export_queue.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+#include "stb_image_write.h"
+#include "util.hpp"
+
+//********************************/
+// ExportQueue implementation
+
+ExportQueue::ExportQueue(int num_threads, int capacity)
+{
+    if (num_threads <= 0)
+    {
+        num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+    }
+    _capacity = capacity > 0 ? capacity : 2 * num_threads;
+
+    for (int i = 0; i < num_threads; i++)
+    {
+        _encoders.emplace_back([this]()
+                               { encoderLoop(); });
+    }
+}
+
+ExportQueue::~ExportQueue()
+{
+    finish();
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _not_empty.notify_all();
+    for (std::thread &encoder : _encoders)
+    {
+        encoder.join();
+    }
+}
+
+void ExportQueue::push(const std::string &path, const RenderResult &result)
+{
+    ExportJob job;
+    job.path = path;
+    job.image.assign(result.image, result.image + result.width * result.height * CHANNELS);
+    job.width = int(result.width);
+    job.height = int(result.height);
+
+    // backpressure: wait for a free slot instead of buffering an unbounded number of images
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_full.wait(lock, [this]()
+                   { return _jobs.size() < _capacity; });
+    _jobs.push_back(std::move(job));
+    lock.unlock();
+    _not_empty.notify_one();
+}
+
+void ExportQueue::finish()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this]()
+               { return _jobs.empty() && _busy == 0; });
+}
+
+int ExportQueue::getFailed()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _failed;
+}
+
+void ExportQueue::encoderLoop()
+{
+    while (true)
+    {
+        ExportJob job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _not_empty.wait(lock, [this]()
+                            { return _stop || !_jobs.empty(); });
+            if (_jobs.empty())
+                return;
+            job = std::move(_jobs.front());
+            _jobs.pop_front();
+            _busy++;
+        }
+        _not_full.notify_one();
+
+        bool written = stbi_write_png(job.path.c_str(), job.width, job.height, CHANNELS, job.image.data(), 0) != 0;
+        if (!written)
+        {
+            std::cerr << "Failed to write " << job.path << "\n";
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _busy--;
+            if (!written)
+                _failed++;
+            if (_jobs.empty() && _busy == 0)
+                _idle.notify_all();
+        }
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gl_renderer.hpp"
+
+//********************************/
+// ExportQueue implementation
+
+// Writes PNG files on a set of encoder threads. push() copies the image, so the caller can
+// render the next result right away; it only blocks while the queue is full.
+class ExportQueue
+{
+public:
+    // num_threads <= 0: hardware concurrency, capacity <= 0: two images per encoder thread
+    ExportQueue(int num_threads = 0, int capacity = 0);
+
+    ~ExportQueue();
+
+    ExportQueue(const ExportQueue &) = delete;
+    ExportQueue &operator=(const ExportQueue &) = delete;
+
+    // queues a copy of the RGBA image for path
+    void push(const std::string &path, const RenderResult &result);
+
+    // blocks until every queued image is written
+    void finish();
+
+    // number of images that could not be written
+    int getFailed();
+
+private:
+    struct ExportJob
+    {
+        std::string path;
+        std::vector<unsigned char> image;
+        int width, height;
+    };
+
+    void encoderLoop();
+
+    std::vector<std::thread> _encoders;
+    std::mutex _mutex;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    std::condition_variable _idle;
+    std::deque<ExportJob> _jobs;
+    size_t _capacity;
+    int _busy = 0;
+    int _failed = 0;
+    bool _stop = false;
+};
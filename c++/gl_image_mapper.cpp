@@ -56,13 +56,13 @@ void ImageMapper::initBuffers()
     createBuffer(nullptr, _size * sizeof(float), 0, _buffers[0]);
     createBuffer(nullptr, _size * sizeof(float), 1, _buffers[1]);
     createBuffer(nullptr, _size * 3 * sizeof(float), 2, _buffers[2]);
-    createBuffer(nullptr, _size * 2 * 3 * sizeof(unsigned int), 3, _buffers[3]);
+    // (the triangles are the shared grid topology, see getGridTriangles)
 
     // MappingTables buffers (in order) (input)
-    createBuffer(nullptr, _width * sizeof(float), 4, _buffers[4]);
+    createBuffer(nullptr, _width * sizeof(float), 3, _buffers[3]);
+    createBuffer(nullptr, _height * sizeof(float), 4, _buffers[4]);
     createBuffer(nullptr, _height * sizeof(float), 5, _buffers[5]);
     createBuffer(nullptr, _height * sizeof(float), 6, _buffers[6]);
-    createBuffer(nullptr, _height * sizeof(float), 7, _buffers[7]);
 }
 
 void ImageMapper::bindBuffers()
@@ -81,10 +81,15 @@ void ImageMapper::loadImageTexture(int width, int height, unsigned char *image)
 
 void ImageMapper::fillBuffers(MappingTables &mapping_tables)
 {
-    glNamedBufferSubData(_buffers[4], 0, _width * sizeof(float), mapping_tables._if_curve_integrals);
-    glNamedBufferSubData(_buffers[5], 0, _height * sizeof(float), mapping_tables._x_a_x);
-    glNamedBufferSubData(_buffers[6], 0, _height * sizeof(float), mapping_tables._a_x_y);
-    glNamedBufferSubData(_buffers[7], 0, _height * sizeof(float), mapping_tables._linear_fit);
+    glNamedBufferSubData(_buffers[3], 0, _width * sizeof(float), mapping_tables._if_curve_integrals);
+    glNamedBufferSubData(_buffers[4], 0, _height * sizeof(float), mapping_tables._x_a_x);
+    glNamedBufferSubData(_buffers[5], 0, _height * sizeof(float), mapping_tables._a_x_y);
+    glNamedBufferSubData(_buffers[6], 0, _height * sizeof(float), mapping_tables._linear_fit);
+}
+
+void ImageMapper::setKeepOnGPU(bool keep_on_gpu)
+{
+    _keep_on_gpu = keep_on_gpu;
 }
 
 void ImageMapper::readBuffers()
@@ -92,7 +97,6 @@ void ImageMapper::readBuffers()
     glGetNamedBufferSubData(_buffers[0], 0, _size * sizeof(float), _result->_x);
     glGetNamedBufferSubData(_buffers[1], 0, _size * sizeof(float), _result->_y);
     glGetNamedBufferSubData(_buffers[2], 0, _size * 3 * sizeof(float), _result->_c);
-    glGetNamedBufferSubData(_buffers[3], 0, _size * 2 * 3 * sizeof(unsigned int), _result->_t);
 }
 
 void ImageMapper::fillUniforms(float arc_length, float interpolation_factor, float radius_modifier, float image_rotation, float vertical_shift, float tilt, float crop_bottom, float crop_top, float crop_left, float crop_right)
@@ -136,7 +140,10 @@ void ImageMapper::map(int width, int height, MappingTables &mapping_tables, floa
     fillBuffers(mapping_tables);
     fillUniforms(arc_length, interpolation_factor, radius_modifier, image_rotation, vertical_shift, tilt, crop_bottom, crop_top, crop_left, crop_right);
     run();
-    readBuffers();
+    if (!_keep_on_gpu)
+    {
+        readBuffers();
+    }
 }
 
 void ImageMapper::run()
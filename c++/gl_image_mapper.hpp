@@ -24,7 +24,7 @@ public:
         _x = new float[size];
         _y = new float[size];
         _c = new float[size * 3];
-        _t = new unsigned int[size * 2 * 3];
+        _t = getGridTriangles(width, height);
     }
 
     ~ImageMapResult()
@@ -32,21 +32,20 @@ public:
         delete[] _x;
         delete[] _y;
         delete[] _c;
-        delete[] _t;
     }
 
     RenderData getRenderData()
     {
-        return {_x, _y, _c, _t};
+        return {_x, _y, _c, _t->data()};
     }
 
     float *_x;
     float *_y;
     float *_c;
-    unsigned int *_t;
+    std::shared_ptr<const std::vector<unsigned int>> _t; // shared grid topology
 };
 
-#define NUM_BUFFERS_IMG 8
+#define NUM_BUFFERS_IMG 7
 class ImageMapper
 {
 public:
@@ -54,14 +53,19 @@ public:
 
     ~ImageMapper();
 
-    GLuint _buffers[NUM_BUFFERS_IMG] = {0, 0, 0, 0, 0, 0, 0, 0};
+    GLuint _buffers[NUM_BUFFERS_IMG] = {0, 0, 0, 0, 0, 0, 0};
     GLuint _image_tex;
     GLuint _program, _program_calc_values;
     int _width = 0, _height = 0, _size = 0;
     ImageMapResult *_result = nullptr;
 
+    // the outputs stay in the buffers for Renderer::renderMapped, _result is not filled
+    bool _keep_on_gpu = false;
+
     void setSize(int width, int height);
 
+    void setKeepOnGPU(bool keep_on_gpu);
+
     void initBuffers();
 
     void bindBuffers();
@@ -11,7 +11,14 @@ Renderer::Renderer()
 
 Renderer::~Renderer()
 {
+    glDeleteBuffers(1, &_bounds);
+    glDeleteBuffers(1, &_ebo_grid);
+    glDeleteBuffers(1, &_tex_coords);
+    glDeleteVertexArrays(1, &_vao_mapped);
     glDeleteProgram(_program);
+    glDeleteProgram(_program_mapped);
+    glDeleteProgram(_program_bounds);
+    glDeleteProgram(_program_textured);
 }
 
 void Renderer::setSize(int width, int height)
@@ -69,6 +76,23 @@ void Renderer::initBuffers()
 
     glGenBuffers(1, &_vbo);
     glGenBuffers(1, &_ebo);
+    glCreateBuffers(1, &_ebo_grid);
+
+    // vertex array of the mapped path, the buffers are attached per render (attribute i from binding i)
+    glCreateVertexArrays(1, &_vao_mapped);
+    glVertexArrayAttribFormat(_vao_mapped, 0, 1, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribFormat(_vao_mapped, 1, 1, GL_FLOAT, GL_FALSE, 0);
+    glVertexArrayAttribFormat(_vao_mapped, 2, 3, GL_FLOAT, GL_FALSE, 0);
+    for (int i = 0; i < 3; i++)
+    {
+        glVertexArrayAttribBinding(_vao_mapped, i, i);
+        glEnableVertexArrayAttrib(_vao_mapped, i);
+    }
+
+    glCreateBuffers(1, &_tex_coords);
+
+    glCreateBuffers(1, &_bounds);
+    glNamedBufferData(_bounds, 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_COPY);
 }
 
 void Renderer::fillBuffersTriangles(RenderData render_data)
@@ -78,14 +102,29 @@ void Renderer::fillBuffersTriangles(RenderData render_data)
     {
         float x_clip = (render_data._x[i] - _c_min_x) / ((_c_max_x - _c_min_x) / 2.0f) - 1.0f;
         float y_clip = -((render_data._y[i] - _c_min_y) / ((_c_max_y - _c_min_y) / 2.0f) - 1.0f);
-        vertices[i] = {x_clip, y_clip, render_data._c[i * 3 + 0], render_data._c[i * 3 + 1], render_data._c[i * 3 + 2]};
+        if (render_data._c)
+            vertices[i] = {x_clip, y_clip, render_data._c[i * 3 + 0], render_data._c[i * 3 + 1], render_data._c[i * 3 + 2]};
+        else
+            vertices[i] = {x_clip, y_clip, 0, 0, 0};
     }
 
     glBindBuffer(GL_ARRAY_BUFFER, _vbo);
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (_width - 1) * (_height - 1) * 2 * 3 * sizeof(unsigned int), render_data._t, GL_STATIC_DRAW);
+    // the triangles are always the grid topology (render_data._t), they stay on the GPU
+    fillGridIndices();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ebo_grid);
+}
+
+void Renderer::fillGridIndices()
+{
+    if (_width == _ebo_grid_width && _height == _ebo_grid_height)
+        return;
+
+    std::shared_ptr<const std::vector<unsigned int>> triangles = getGridTriangles(_width, _height);
+    glNamedBufferData(_ebo_grid, triangles->size() * sizeof(unsigned int), triangles->data(), GL_STATIC_DRAW);
+    _ebo_grid_width = _width;
+    _ebo_grid_height = _height;
 }
 
 void Renderer::fillBuffersLines(RenderData render_data, int num_points, int num_indices)
@@ -123,11 +162,71 @@ void Renderer::createProgram()
     glLinkProgram(_program);
     glDeleteShader(vertex_shader);
     glDeleteShader(fragment_shader);
+
+    std::string m_shader_source = loadShaderSource("shaders/render_mapped.vert");
+    GLuint mapped_shader = compileShader(GL_VERTEX_SHADER, m_shader_source.c_str());
+    fragment_shader = compileShader(GL_FRAGMENT_SHADER, f_shader_source.c_str());
+    _program_mapped = glCreateProgram();
+    glAttachShader(_program_mapped, mapped_shader);
+    glAttachShader(_program_mapped, fragment_shader);
+    glLinkProgram(_program_mapped);
+    glDeleteShader(mapped_shader);
+    glDeleteShader(fragment_shader);
+
+    std::string t_shader_source = loadShaderSource("shaders/render_textured.vert");
+    std::string tf_shader_source = loadShaderSource("shaders/render_textured.frag");
+    GLuint textured_shader = compileShader(GL_VERTEX_SHADER, t_shader_source.c_str());
+    fragment_shader = compileShader(GL_FRAGMENT_SHADER, tf_shader_source.c_str());
+    _program_textured = glCreateProgram();
+    glAttachShader(_program_textured, textured_shader);
+    glAttachShader(_program_textured, fragment_shader);
+    glLinkProgram(_program_textured);
+    glDeleteShader(textured_shader);
+    glDeleteShader(fragment_shader);
+
+    std::string b_shader_source = loadShaderSource("shaders/bounds.comp");
+    GLuint bounds_shader = compileShader(GL_COMPUTE_SHADER, b_shader_source.c_str());
+    _program_bounds = glCreateProgram();
+    glAttachShader(_program_bounds, bounds_shader);
+    glLinkProgram(_program_bounds);
+    glDeleteShader(bounds_shader);
+}
+
+// inverse of encode() in bounds.comp
+static float decodeBound(GLuint u)
+{
+    u = (u & 0x80000000u) ? u & 0x7fffffffu : ~u;
+    float f;
+    std::memcpy(&f, &u, sizeof(f));
+    return f;
 }
 
-void Renderer::readResult()
+void Renderer::computeBounds(GLuint x_buffer, GLuint y_buffer)
+{
+    GLuint initial[4] = {0xffffffffu, 0u, 0xffffffffu, 0u};
+    glNamedBufferSubData(_bounds, 0, sizeof(initial), initial);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, x_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, y_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, _bounds);
+
+    glUseProgram(_program_bounds);
+    glUniform1ui(glGetUniformLocation(_program_bounds, "size"), _size);
+    glDispatchCompute(std::min((_size + 255) / 256, BOUNDS_MAX_GROUPS), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    GLuint bounds[4];
+    glGetNamedBufferSubData(_bounds, 0, sizeof(bounds), bounds);
+    _c_min_x = decodeBound(bounds[0]);
+    _c_max_x = decodeBound(bounds[1]);
+    _c_min_y = decodeBound(bounds[2]);
+    _c_max_y = decodeBound(bounds[3]);
+}
+
+unsigned char *Renderer::readResult()
 {
     glReadPixels(0, 0, _render_width, _render_height, GL_RGBA, GL_UNSIGNED_BYTE, _output_buffer.data());
+    return _output_buffer.data();
 }
 
 RenderResult Renderer::renderTriangles(int width, int height, int render_size, RenderData render_data)
@@ -152,9 +251,7 @@ RenderResult Renderer::renderTriangles(int width, int height, int render_size, R
 
     runTriangles();
 
-    readResult();
-
-    return {_output_buffer.data(), (size_t)_render_width, (size_t)_render_height};
+    return {readResult(), (size_t)_render_width, (size_t)_render_height};
 }
 
 RenderResult Renderer::renderLines(int width, int height, int num_points, int num_indices, int render_size, bool render_on_top, int line_size, RenderData render_data)
@@ -177,9 +274,60 @@ RenderResult Renderer::renderLines(int width, int height, int num_points, int nu
 
     runLines(num_indices, render_on_top, line_size);
 
-    readResult();
+    return {readResult(), (size_t)_render_width, (size_t)_render_height};
+}
+
+RenderResult Renderer::renderTexturedTriangles(int width, int height, int render_size, RenderData render_data, GridTexCoords tex_coords, GLuint texture)
+{
+    setSize(width, height);
+
+    _c_min_x = *std::min_element(render_data._x, render_data._x + _size);
+    _c_max_x = *std::max_element(render_data._x, render_data._x + _size);
+    _c_min_y = *std::min_element(render_data._y, render_data._y + _size);
+    _c_max_y = *std::max_element(render_data._y, render_data._y + _size);
+
+    float ratio = std::abs(_c_max_y - _c_min_y) / std::abs(_c_max_x - _c_min_x);
+
+    setRenderSize(render_size, ratio);
+
+    fillBuffersTriangles(render_data);
+
+    runTexturedTriangles(tex_coords, texture);
+
+    return {readResult(), (size_t)_render_width, (size_t)_render_height};
+}
+
+RenderResult Renderer::renderMapped(int width, int height, int render_size, GLuint x_buffer, GLuint y_buffer, GLuint c_buffer)
+{
+    setSize(width, height);
+
+    // the bounds are also kept for the grid drawn on top
+    computeBounds(x_buffer, y_buffer);
+
+    float ratio = std::abs(_c_max_y - _c_min_y) / std::abs(_c_max_x - _c_min_x);
+
+    setRenderSize(render_size, ratio);
+
+    glVertexArrayVertexBuffer(_vao_mapped, 0, x_buffer, 0, sizeof(float));
+    glVertexArrayVertexBuffer(_vao_mapped, 1, y_buffer, 0, sizeof(float));
+    glVertexArrayVertexBuffer(_vao_mapped, 2, c_buffer, 0, 3 * sizeof(float));
+    fillGridIndices();
+    glVertexArrayElementBuffer(_vao_mapped, _ebo_grid);
+
+    // the compute shader wrote the buffers as storage buffers
+    glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+    glViewport(0, 0, _render_width, _render_height);
+    glClearColor(1.0, 1.0, 1.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
 
-    return {_output_buffer.data(), (size_t)_render_width, (size_t)_render_height};
+    glUseProgram(_program_mapped);
+    glBindVertexArray(_vao_mapped);
+    glDrawElements(GL_TRIANGLES, (_width - 1) * (_height - 1) * 2 * 3, GL_UNSIGNED_INT, 0);
+    // the other paths fill _vao
+    glBindVertexArray(_vao);
+
+    return {readResult(), (size_t)_render_width, (size_t)_render_height};
 }
 
 void Renderer::runTriangles()
@@ -205,6 +353,32 @@ void Renderer::runTriangles()
     glDrawElements(GL_TRIANGLES, (_width - 1) * (_height - 1) * 2 * 3, GL_UNSIGNED_INT, 0);
 }
 
+void Renderer::runTexturedTriangles(GridTexCoords tex_coords, GLuint texture)
+{
+    glViewport(0, 0, _render_width, _render_height);
+    glClearColor(1.0, 1.0, 1.0, 0.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glUseProgram(_program_textured);
+    glUniform1ui(glGetUniformLocation(_program_textured, "width"), _width);
+
+    glNamedBufferData(_tex_coords, (_width + _height) * sizeof(float), nullptr, GL_STREAM_DRAW);
+    glNamedBufferSubData(_tex_coords, 0, _width * sizeof(float), tex_coords.u);
+    glNamedBufferSubData(_tex_coords, _width * sizeof(float), _height * sizeof(float), tex_coords.v);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TEX_COORDS_BINDING, _tex_coords);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glUniform1i(glGetUniformLocation(_program_textured, "input_image"), 0);
+
+    GLint pos_loc = glGetAttribLocation(_program_textured, "aPos");
+
+    glEnableVertexAttribArray(pos_loc);
+    glVertexAttribPointer(pos_loc, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+
+    glDrawElements(GL_TRIANGLES, (_width - 1) * (_height - 1) * 2 * 3, GL_UNSIGNED_INT, 0);
+}
+
 void Renderer::runPoints(int num_points, bool render_on_top)
 {
     if (!render_on_top)
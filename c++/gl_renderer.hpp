@@ -25,6 +25,10 @@ typedef struct RenderResult
     size_t height;
 } __RenderResult__;
 
+#define BOUNDS_BINDING 8        // storage buffer binding of the bounds in bounds.comp and render_mapped.vert
+#define BOUNDS_MAX_GROUPS 256   // work groups of the bounds reduction (grid-stride beyond that)
+#define TEX_COORDS_BINDING 9    // storage buffer binding of the texture coordinates in render_textured.vert
+
 class Renderer
 {
 public:
@@ -33,7 +37,12 @@ public:
     ~Renderer();
 
     GLuint _fbo, _tex, _vao, _vbo, _ebo;
+    GLuint _ebo_grid; // triangles of the _width x _height grid, only uploaded when the size changes
+    int _ebo_grid_width = 0, _ebo_grid_height = 0;
     GLuint _program;
+    GLuint _program_mapped, _program_bounds, _program_textured;
+    GLuint _vao_mapped, _bounds;
+    GLuint _tex_coords; // u per column followed by v per row
     int _width = 0, _height = 0, _size = 0;
     int _render_width = 0, _render_height = 0;
     std::vector<unsigned char> _output_buffer;
@@ -48,20 +57,36 @@ public:
 
     void fillBuffersTriangles(RenderData render_data);
 
+    void fillGridIndices();
+
     void fillBuffersLines(RenderData render_data, int num_points, int num_indices);
 
     void fillUniforms(int point_size);
 
     void createProgram();
 
-    void readResult();
+    // min/max of the mapped points on the GPU, only the 4 bounds are read back (for the render size)
+    void computeBounds(GLuint x_buffer, GLuint y_buffer);
+
+    // pixels of the last render
+    unsigned char *readResult();
 
     RenderResult renderTriangles(int width, int height, int render_size, RenderData render_data);
 
+    // triangles of a width x height grid, the fragments sample texture at the interpolated texture
+    // coordinates of the vertices (the vertex colours are not used)
+    RenderResult renderTexturedTriangles(int width, int height, int render_size, RenderData render_data, GridTexCoords tex_coords, GLuint texture);
+
     RenderResult renderLines(int width, int height, int num_points, int num_indices, int render_size, bool render_on_top, int line_size, RenderData render_data);
 
+    // renders the output buffers of the ImageMapper in place as vertex sources (with the grid
+    // triangles), the mesh never leaves the GPU
+    RenderResult renderMapped(int width, int height, int render_size, GLuint x_buffer, GLuint y_buffer, GLuint c_buffer);
+
     void runTriangles();
 
+    void runTexturedTriangles(GridTexCoords tex_coords, GLuint texture);
+
     void runPoints(int num_points, bool render_on_top);
 
     void runLines(int num_indices, bool render_on_top, int line_size);
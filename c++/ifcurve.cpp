@@ -10,6 +10,14 @@ IFCurve::IFCurve(float d_factor, float interpolation_factor)
     setInterpolationFactor(interpolation_factor);
 }
 
+// independent copy (e.g. per optimizer start), the function is cloned
+IFCurve::IFCurve(const IFCurve &other)
+    : _d_lower_bound(other._d_lower_bound), _d_upper_bound(other._d_upper_bound),
+      _d_factor(other._d_factor), _interpolation_factor(other._interpolation_factor)
+{
+    function = other.function->clone();
+}
+
 IFCurve::~IFCurve()
 {
     delete function;
@@ -40,6 +48,12 @@ void IFCurve::setDBounds(float lower, float upper)
     setDFactor(_d_factor);
 }
 
+void IFCurve::getDBounds(float &lower, float &upper)
+{
+    lower = _d_lower_bound;
+    upper = _d_upper_bound;
+}
+
 IFCurveFunction *IFCurve::getFunction()
 {
     return function;
@@ -3,6 +3,8 @@
 #include <functional>
 #include <iostream>
 
+#include "dual.hpp"
+
 class IFCurveFunction;
 
 typedef struct OptData
@@ -20,6 +22,13 @@ public:
     virtual float integrate(float lower_bound, float upper_bound) = 0;
     virtual void update(float d, float IF) = 0;
     virtual float operator()(float x) = 0;
+    virtual IFCurveFunction *clone() const = 0;
+
+    // integral and value for parameters given as Dual (d-value and interpolation factor as in update)
+    // the result carries the derivatives with respect to whatever d and IF depend on
+    virtual Dual integrate(float lower_bound, float upper_bound, const Dual &d, const Dual &IF) const = 0;
+    virtual Dual operator()(float x, const Dual &d, const Dual &IF) const = 0;
+    virtual ~IFCurveFunction() = default;
 };
 
 class QuadraticFunction : public IFCurveFunction
@@ -57,6 +66,23 @@ public:
         return (_a * pow(x, 2)) + _d;
     }
 
+    IFCurveFunction *clone() const override
+    {
+        return new QuadraticFunction(*this);
+    }
+
+    Dual integrate(float lower_bound, float upper_bound, const Dual &d, const Dual &IF) const override
+    {
+        Dual a = 3 * (IF - d);
+        return (a * ((pow(upper_bound, 3) - pow(lower_bound, 3)) / 3)) + d * (upper_bound - lower_bound);
+    }
+
+    Dual operator()(float x, const Dual &d, const Dual &IF) const override
+    {
+        Dual a = 3 * (IF - d);
+        return (a * pow(x, 2)) + d;
+    }
+
 private:
     float _a = 0.5;
     float _d = 0.5;
@@ -66,12 +92,15 @@ class IFCurve
 {
 public:
     IFCurve(float d_factor, float interpolation_factor);
+    IFCurve(const IFCurve &other);
+    IFCurve &operator=(const IFCurve &) = delete;
 
     ~IFCurve();
 
     void setInterpolationFactor(float interpolation_factor);
     void setDFactor(float d_factor);
     void setDBounds(float lower, float upper);
+    void getDBounds(float &lower, float &upper);
     IFCurveFunction *getFunction();
     float operator()(float x);
 
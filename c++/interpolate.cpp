@@ -2,10 +2,13 @@
 #include <iostream>
 #include "model.hpp"
 #include <cmath>
+#include <memory>
 #include "util.hpp"
 #include "stb_image.h"
 #include "stb_image_write.h"
 #include "timer.hpp"
+#include "sweep_file.hpp"
+#include "export_queue.hpp"
 
 // auxiliary tool for the paper, not for production uses
 int main(int argc, char *argv[])
@@ -15,6 +18,10 @@ int main(int argc, char *argv[])
         assert(false && "Failed to initialized GLFW Library");
     }
     GLFWwindow *w = initGLFWContext();
+    if (w == nullptr)
+    {
+        return 1;
+    }
 
     cxxopts::Options options("AnRoll CMD", "Model Parameters");
 
@@ -25,6 +32,7 @@ int main(int argc, char *argv[])
     options.add_options()("s,scale", "Image Resolution [0,1]", cxxopts::value<float>()->default_value("0.5"));
     options.add_options()("export-result", "Export Result", cxxopts::value<bool>()->default_value("false"));
     options.add_options()("export-error-maps", "Export Error Maps", cxxopts::value<bool>()->default_value("false"));
+    options.add_options()("export-threads", "PNG Encoder Threads (0 = all cores)", cxxopts::value<int>()->default_value("0"));
     options.add_options()("grid-active", "Grid Active", cxxopts::value<bool>()->default_value("false"));
     options.add_options()("grid-uniform", "Grid Uniform", cxxopts::value<bool>()->default_value("false"));
     options.add_options()("x,grid-x", "Grid Lines Horizontal", cxxopts::value<int>()->default_value("21"));
@@ -33,6 +41,8 @@ int main(int argc, char *argv[])
     options.add_options()("image-active", "Image Active", cxxopts::value<bool>()->default_value("true"));
     options.add_options()("smoothing", "Contour Smoothing", cxxopts::value<float>()->default_value("0.001"));
     options.add_options()("dist-quality", "Distortion Map Fidelity", cxxopts::value<float>()->default_value("1.0"));
+    options.add_options()("b,output-binary", "Binary Sweep File Path (resumes an interrupted sweep, replaces the text output)", cxxopts::value<std::string>()->default_value(""));
+    options.add_options()("chunk-points", "Points per Chunk of the Binary Sweep File", cxxopts::value<int>()->default_value("4096"));
 
     // bounds
     options.add_options()("if-low", "IF lower bound", cxxopts::value<float>()->default_value("0.0"));
@@ -58,6 +68,7 @@ int main(int argc, char *argv[])
     float scale = result["scale"].as<float>();
     bool export_result = result["export-result"].as<bool>();
     bool export_error_maps = result["export-error-maps"].as<bool>();
+    int export_threads = result["export-threads"].as<int>();
     bool image_active = result["image-active"].as<bool>();
     bool grid_active = result["grid-active"].as<bool>();
     bool grid_uniform = result["grid-uniform"].as<bool>();
@@ -69,6 +80,9 @@ int main(int argc, char *argv[])
 
     float dist_quality = result["dist-quality"].as<float>();
 
+    std::string output_binary = result["output-binary"].as<std::string>();
+    int chunk_points = result["chunk-points"].as<int>();
+
     float if_low = result["if-low"].as<float>();
     float if_high = result["if-high"].as<float>();
     int if_steps = result["if-steps"].as<int>();
@@ -97,6 +111,8 @@ int main(int argc, char *argv[])
     int channels;
     unsigned char *mask_raw = stbi_load(mask.c_str(), &width, &height, &channels, CHANNELS);
     loadMask(mask_raw, width, height, x, a_x, y);
+    int mask_width = width;
+    int mask_height = height;
 
     // load model
     Model *model = new Model(x, a_x, y);
@@ -117,32 +133,31 @@ int main(int argc, char *argv[])
     model->getModelPublicProperties()._spline_smoothing.setValue({smoothing, true});
     model->getModelPublicProperties()._error_map_quality.setValue({dist_quality, true});
 
-    long long image_render_time = 0;
-    int rendered = 0;
+    // sweep points in output order, points with the same d-value as their predecessor are skipped
+    std::vector<SweepPoint> points;
+    std::vector<float> d_factors; // d-factor of each point (d_value follows the IF without a d range)
     for (int if_i = 0; if_i < (if_high == if_low ? 1 : if_steps); if_i++)
     {
-        float interp_i = if_i / float(if_steps - 1);
+        float interp_i = if_steps > 1 ? if_i / float(if_steps - 1) : 0;
         float val_if = mix(if_low, if_high, interp_i);
 
-        // set if
-        model->getModelPublicProperties()._interpolation_factor.setValue({val_if, true});
-        model->updateBetaBounds();
+        float d_lower, d_upper;
+        model->getDBounds(val_if, d_lower, d_upper);
         float prev_d = -INFINITY;
         for (int d_i = 0; d_i < (d_high == d_low ? 1 : d_steps); d_i++)
         {
-            float interp_d = d_i / float(d_steps - 1);
+            float interp_d = d_steps > 1 ? d_i / float(d_steps - 1) : 0;
             float val_d = mix(d_low, d_high, interp_d);
+            float d_factor = val_d;
 
-            // set d-val
+            // d-value as set by IFCurve::setDFactor
             if (d_low == d_high)
             {
-                model->getIFCurve()->getFunction()->update(val_if, val_if);
                 val_d = val_if;
             }
             else
             {
-                model->getModelPublicProperties()._d_factor.setValue({val_d, true});
-                val_d = model->getIFCurve()->getFunction()->getParams()[1];
+                val_d = d_lower + d_factor * (d_upper - d_lower);
             }
 
             if (prev_d == val_d)
@@ -154,64 +169,139 @@ int main(int argc, char *argv[])
 
             for (int r_i = 0; r_i < (r_high == r_low ? 1 : r_steps); r_i++)
             {
-                float interp_r = r_i / float(r_steps - 1);
+                float interp_r = r_steps > 1 ? r_i / float(r_steps - 1) : 0;
                 float val_r = mix(r_low, r_high, interp_r);
 
-                // set r
-                model->getModelPublicProperties()._radius_modifier.setValue({val_r, true});
+                points.push_back({val_if, val_d, val_r});
+                d_factors.push_back(d_factor);
+            }
+        }
+    }
+
+    // binary output: the points of a previous run of the same sweep are skipped
+    SweepFileWriter sweep_file;
+    if (!output_binary.empty())
+    {
+        SweepFileHeader header = createSweepFileHeader(std::max(1, chunk_points), points.size());
+        header.if_low = if_low;
+        header.if_high = if_high;
+        header.if_steps = if_steps;
+        header.d_low = d_low;
+        header.d_high = d_high;
+        header.d_steps = d_steps;
+        header.r_low = r_low;
+        header.r_high = r_high;
+        header.r_steps = r_steps;
+        header.enforce_isotropy = y_distortion;
+        header.smoothing = smoothing;
+        header.dist_quality = dist_quality;
+        header.scale = scale;
+        header.mask_crc = crc32(mask_raw, size_t(mask_width) * mask_height * CHANNELS);
+        header.mask_width = mask_width;
+        header.mask_height = mask_height;
+        header.image_crc = crc32(img, size_t(width) * height * CHANNELS);
+        header.image_width = width;
+        header.image_height = height;
+
+        long long resumed_points = sweep_file.open(output_binary, header);
+        if (resumed_points < 0)
+        {
+            return 1;
+        }
+        if (resumed_points > 0)
+        {
+            std::cerr << "Resuming sweep after " << resumed_points << " of " << points.size() << " points\n";
+        }
+        points.erase(points.begin(), points.begin() + resumed_points);
+        d_factors.erase(d_factors.begin(), d_factors.begin() + resumed_points);
+    }
+
+    // the error sums are computed in parallel, the output (and the exports) follow the point order
+    // the PNG files are encoded in the background while the next points are rendered
+    std::unique_ptr<ExportQueue> exports;
+    if (export_error_maps || export_result)
+    {
+        exports = std::make_unique<ExportQueue>(export_threads);
+    }
+    long long image_render_time = 0;
+    int rendered = 0;
+    model->sweepErrors(points, [&](int first_point, const std::vector<ErrorSums> &sums)
+                       {
+        for (int i = 0; i < int(sums.size()); i++)
+        {
+            const SweepPoint &point = points[first_point + i];
+            float val_if = point.interpolation_factor;
+            float val_d = point.d_value;
+            float val_r = point.radius_modifier;
 
+            if (export_error_maps || export_result)
+            {
+                model->getModelPublicProperties()._interpolation_factor.setValue({val_if, true});
+                model->getModelPublicProperties()._radius_modifier.setValue({val_r, true});
+                if (d_low != d_high)
+                {
+                    model->getModelPublicProperties()._d_factor.setValue({d_factors[first_point + i], true});
+                }
                 model->updateState();
+                model->getIFCurve()->getFunction()->update(val_d, val_if);
+            }
+
+            if (export_error_maps)
+            {
                 model->mapErrors();
+                auto eres = model->renderError(0);
+                exports->push(std::string("err_h_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png"), eres);
+                eres = model->renderError(1);
+                exports->push(std::string("err_v_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png"), eres);
+                eres = model->renderError(3);
+                exports->push(std::string("err_r_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png"), eres);
+                eres = model->renderError(4);
+                exports->push(std::string("err_a_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png"), eres);
+            }
 
-                if (export_error_maps)
+            if (export_result)
+            {
+                RenderResult r;
+                Timer *image_timer = new Timer("Render Time", true);
+                if (image_active)
                 {
-                    auto eres = model->renderError(0);
-                    stbi_write_png(std::string("err_h_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png").c_str(), eres.width, eres.height, CHANNELS, eres.image, 0);
-                    eres = model->renderError(1);
-                    stbi_write_png(std::string("err_v_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png").c_str(), eres.width, eres.height, CHANNELS, eres.image, 0);
-                    eres = model->renderError(3);
-                    stbi_write_png(std::string("err_r_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png").c_str(), eres.width, eres.height, CHANNELS, eres.image, 0);
-                    eres = model->renderError(4);
-                    stbi_write_png(std::string("err_a_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png").c_str(), eres.width, eres.height, CHANNELS, eres.image, 0);
+                    r = model->renderImage();
                 }
-
-                if (export_result)
+                if (grid_active)
                 {
-                    RenderResult r;
-                    Timer *image_timer = new Timer("Render Time", true);
-                    if (image_active)
-                    {
-                        r = model->renderImage();
-                    }
-                    if (grid_active)
-                    {
-                        r = model->renderGrid();
-                    }
-                    image_render_time += image_timer->getElapsedTimeMicroseconds();
-                    delete image_timer;
-                    rendered++;
-                    if (image_active || grid_active)
-                    {
-                        stbi_write_png(std::string("res_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png").c_str(), r.width, r.height, CHANNELS, r.image, 0);
-                    }
+                    r = model->renderGrid();
                 }
-
-                float eh = 0.0f;
-                float ev = 0.0f;
-                float er = 0.0f;
-                float ea = 0.0f;
-                int pixels = model->getCPUErrorMapper()->_result->_width * model->getCPUErrorMapper()->_result->_height;
-                for (int x = 0; x < pixels; x++)
+                image_render_time += image_timer->getElapsedTimeMicroseconds();
+                delete image_timer;
+                rendered++;
+                if (image_active || grid_active)
                 {
-                    eh += model->getCPUErrorMapper()->_result->getWeightedError(x, {1.0, 0.0, 0.0, 0.0});
-                    ev += model->getCPUErrorMapper()->_result->getWeightedError(x, {0.0, 1.0, 0.0, 0.0});
-                    er += model->getCPUErrorMapper()->_result->getWeightedError(x, {0.0, 0.0, 1.0, 0.0});
-                    ea += model->getCPUErrorMapper()->_result->getWeightedError(x, {0.0, 0.0, 0.0, 1.0});
+                    exports->push(std::string("res_if=").append(std::to_string(val_if)).append("_d=").append(std::to_string(val_d)).append("_r=").append(std::to_string(val_r)).append("_ef=").append(y_distortion ? "true" : "false").append(".png"), r);
                 }
-                // format this so that each error is aligned to 10 characters
-                // std::cout << "DATA:" << val_if << "," << val_d << "," << val_r << "," << eh / pixels << "," << ev / pixels << "," << er / pixels << "," << ea / pixels << "\n";
-                std::cout << val_if << ";" << val_d << ";" << val_r << ";" << eh << ";" << ev << ";" << er << ";" << ea << "\n";
             }
+
+            // format this so that each error is aligned to 10 characters
+            // std::cout << "DATA:" << val_if << "," << val_d << "," << val_r << "," << eh / pixels << "," << ev / pixels << "," << er / pixels << "," << ea / pixels << "\n";
+            if (!output_binary.empty())
+            {
+                float values[SWEEP_COLUMNS] = {val_if, val_d, val_r, float(sums[i].x), float(sums[i].y), float(sums[i].r), float(sums[i].a)};
+                sweep_file.write(values);
+            }
+            else
+            {
+                std::cout << val_if << ";" << val_d << ";" << val_r << ";" << float(sums[i].x) << ";" << float(sums[i].y) << ";" << float(sums[i].r) << ";" << float(sums[i].a) << "\n";
+            }
+        }
+        std::cout.flush(); });
+    sweep_file.close();
+    int failed_exports = 0;
+    if (exports)
+    {
+        exports->finish();
+        failed_exports = exports->getFailed();
+        if (failed_exports > 0)
+        {
+            std::cerr << failed_exports << " images could not be written\n";
         }
     }
 
@@ -222,5 +312,5 @@ int main(int argc, char *argv[])
     destroyGLFWWindow(w);
     stbi_image_free(mask_raw);
     stbi_image_free(img);
-    return 0;
+    return failed_exports > 0 ? 1 : 0;
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <chrono>
+#include <mutex>
 
 #include <boost/math/statistics/linear_regression.hpp>
 #include <boost/math/quadrature/gauss.hpp>
@@ -25,8 +26,10 @@ using namespace boost::math::statistics;
 #include "stb_image.h"
 
 #include "timer.hpp"
+#include "png_writer.hpp"
 
 #define CHANNELS 4
+#define EXPORT_BAND_BYTES (64 << 20) // RGBA rows warped and encoded at once by exportImage
 
 Model::Model(std::vector<float> &x, std::vector<float> &a_x, std::vector<float> &y)
     : _x(x), _a_x(a_x), _y(y)
@@ -39,12 +42,12 @@ Model::Model(std::vector<float> &x, std::vector<float> &a_x, std::vector<float>
 
     createSplines(_public_properties._spline_smoothing);
 
-    linearFit();
+    updateContour();
 
-    _image_mapper = new ImageMapper();
+    _cpu_image_mapper = new CPUImageMapper();
     _error_mapper = new ErrorMapper();
-    _grid_mapper = new GridMapper();
-    _renderer = new Renderer();
+    _grid_mapper = new CPUGridMapper();
+    _cpu_renderer = new CPURenderer();
     _ifcurve = new IFCurve(_public_properties._d_factor, _public_properties._interpolation_factor);
 
     registerObservers();
@@ -58,9 +61,11 @@ Model::~Model()
     }
 
     delete _image_mapper;
+    delete _cpu_image_mapper;
     delete _grid_mapper;
     delete _error_mapper;
     delete _renderer;
+    delete _cpu_renderer;
     delete _ifcurve;
 }
 
@@ -80,6 +85,9 @@ void Model::createSplines(float smoothing)
     alglib::spline1dbuildmonotone(x, a_x, _x_a_x_spline);
     size_t num_knots = std::max(4, (int)_a_x.size() / 2);
     alglib::spline1dfit(a_x, y, num_knots, double(smoothing), _a_x_y_spline, report);
+
+    _x_a_x_cubic.set(_x_a_x_spline);
+    _a_x_y_cubic.set(_a_x_y_spline);
 }
 
 void Model::setImage(unsigned char *image, int width, int height)
@@ -90,7 +98,12 @@ void Model::setImage(unsigned char *image, int width, int height)
     _image_width = width;
     _image_height = height;
 
-    _image_mapper->loadImageTexture(_image_width, _image_height, _image);
+    _cpu_image_mapper->loadImage(_image_width, _image_height, _image);
+    // uploaded when the GL mapper needs it
+    _image_texture_loaded = false;
+
+    // the mesh carries the colours of the image
+    _image_stage.invalidate();
 }
 
 void Model::cropTop(float amount)
@@ -98,7 +111,7 @@ void Model::cropTop(float amount)
     // this is reversed because of how the mask data is stored
     float tmp = _height * amount;
     _x_bounds.setLowerBound(tmp);
-    _a_x_bounds.setLowerBound(alglib::spline1dcalc(_x_a_x_spline, tmp));
+    _a_x_bounds.setLowerBound(_x_a_x_cubic(tmp));
 }
 
 void Model::cropBottom(float amount)
@@ -106,7 +119,7 @@ void Model::cropBottom(float amount)
     // this is reversed because of how the mask data is stored
     float tmp = _height * (1 - amount);
     _x_bounds.setUpperBound(tmp);
-    _a_x_bounds.setUpperBound(alglib::spline1dcalc(_x_a_x_spline, tmp));
+    _a_x_bounds.setUpperBound(_x_a_x_cubic(tmp));
 }
 
 #define LIN_FIT_SAMPLES 30
@@ -115,59 +128,172 @@ void Model::linearFit()
     std::vector<float> tmp_a_x;
     linspace(tmp_a_x, _a_x_bounds._lower, _a_x_bounds._upper, LIN_FIT_SAMPLES);
 
-    std::vector<float> tmp_y;
-    std::transform(tmp_a_x.begin(), tmp_a_x.end(), std::back_inserter(tmp_y), [this](float value)
-                   { return alglib::spline1dcalc(_a_x_y_spline, value); });
+    std::vector<float> tmp_y(tmp_a_x.size());
+    _a_x_y_cubic.evaluate(tmp_a_x.data(), int(tmp_a_x.size()), tmp_y.data());
 
     std::tie(_intercept, _slope) = simple_ordinary_least_squares(tmp_a_x, tmp_y);
 }
 
-// directly calculate the adjusted h_a based on the integral the spline is based on
-float Model::getEFHeight(float h_a)
+#define ISOTROPY_TABLE_NODES 1025
+
+// the x-distortion is (1 - if_0) * r_linear / r_contour + if_0, so every getEFHeight(h_a, if_0) follows
+// from the integral of r_linear / r_contour alone, independent of the IF curve
+void Model::setupIsotropyTable()
 {
-    float if_0 = (*_ifcurve)(0);
-    auto x_distortion = [this, if_0](float h_a) -> float
+    auto ratio = [this](double h_a) -> double
     {
-        float r_contour = alglib::spline1dcalc(_a_x_y_spline, h_a);
-        float r_linear = _slope * h_a + _intercept;
-        float circ_interp = (r_linear + (r_contour - r_linear) * if_0) * 2 * M_PI;
-        float circ_real = r_contour * 2 * M_PI;
-        return circ_interp / circ_real;
+        return (_slope * h_a + _intercept) / _a_x_y_cubic(h_a);
     };
 
-    boost::math::quadrature::gauss_kronrod<float, 61> integrator;
-
-    float tol = 1e-10;
-    return integrator.integrate(x_distortion, 0.0, h_a, tol);
+    _isotropy_integral.resize(ISOTROPY_TABLE_NODES);
+    _isotropy_integrand.resize(ISOTROPY_TABLE_NODES);
+    double step = double(_arc_length) / (ISOTROPY_TABLE_NODES - 1);
+    double integral = 0;
+    for (int i = 0; i < ISOTROPY_TABLE_NODES; i++)
+    {
+        if (i > 0)
+        {
+            integral += boost::math::quadrature::gauss<double, 7>::integrate(ratio, (i - 1) * step, i * step);
+        }
+        _isotropy_integral[i] = float(integral);
+        _isotropy_integrand[i] = float(ratio(i * step));
+    }
 }
 
-void Model::setupMappingTables(int width, int height, MappingTables &mapping_tables, bool alp) // arc-length-parametrized (y uniformity)
+// integral of r_linear / r_contour from 0 to h_a: cubic hermite interpolation of the table
+float Model::getIsotropyIntegral(float h_a)
 {
-    for (int w = 0; w < width; w++)
+    if (h_a < 0 || h_a > _arc_length)
     {
-        float x = mix(float(_public_properties._crop_left), float(1 - _public_properties._crop_right), (double)w / (width - 1));
-        x = (x - 0.5) * 2; // map to [-1, 1]
-        mapping_tables._if_curve_integrals[w] = _ifcurve->getFunction()->integrate(0, abs(x));
+        // outside of the contour (jittered rows), not worth a table
+        auto ratio = [this](float h_a) -> float
+        {
+            return (_slope * h_a + _intercept) / _a_x_y_cubic(h_a);
+        };
+        boost::math::quadrature::gauss_kronrod<float, 61> integrator;
+        return integrator.integrate(ratio, 0.0f, h_a, 1e-10f);
     }
 
-    for (int h = 0; h < height; h++)
-    {
-        float y = (float)h / (height - 1);
-        float h_z = _x_bounds.interp(y);
-        float h_a = alp ? _a_x_bounds.interp(y) : alglib::spline1dcalc(_x_a_x_spline, h_z);
+    float step = _arc_length / (ISOTROPY_TABLE_NODES - 1);
+    float t = h_a / step;
+    int i = std::min(int(t), ISOTROPY_TABLE_NODES - 2);
+    float s = t - i;
+    float s2 = s * s, s3 = s2 * s;
+    return (2 * s3 - 3 * s2 + 1) * _isotropy_integral[i] + (s3 - 2 * s2 + s) * step * _isotropy_integrand[i] +
+           (-2 * s3 + 3 * s2) * _isotropy_integral[i + 1] + (s3 - s2) * step * _isotropy_integrand[i + 1];
+}
 
-        mapping_tables._a_x_y[h] = alglib::spline1dcalc(_a_x_y_spline, h_a);
-        mapping_tables._linear_fit[h] = _slope * h_a + _intercept;
+// x-error at x=0 and height h_a (the integrand of getEFHeight)
+float Model::getXDistortion(float h_a, float if_0)
+{
+    float r_contour = _a_x_y_cubic(h_a);
+    float r_linear = _slope * h_a + _intercept;
+    float circ_interp = (r_linear + (r_contour - r_linear) * if_0) * 2 * M_PI;
+    float circ_real = r_contour * 2 * M_PI;
+    return circ_interp / circ_real;
+}
 
-        if (_public_properties._enforce_isotropy) // modify h_a based on the x-error at x=0 and height h
+// directly calculate the adjusted h_a based on the integral the spline is based on
+float Model::getEFHeight(float h_a)
+{
+    return getEFHeight(h_a, (*_ifcurve)(0));
+}
+
+// if_0: value of the IF curve at x=0
+float Model::getEFHeight(float h_a, float if_0)
+{
+    return (1 - if_0) * getIsotropyIntegral(h_a) + if_0 * h_a;
+}
+
+// derivative of getEFHeight with respect to if_0 (the x-distortion is linear in if_0)
+float Model::getEFHeightDerivative(float h_a)
+{
+    return h_a - getIsotropyIntegral(h_a);
+}
+
+ContourKey Model::getContourKey()
+{
+    return {_public_properties._spline_smoothing, _public_properties._crop_top, _public_properties._crop_bottom};
+}
+
+RowTablesKey Model::getRowTablesKey(int height, bool alp)
+{
+    bool enforce_isotropy = _public_properties._enforce_isotropy;
+    return {getContourKey(), height, alp, enforce_isotropy, enforce_isotropy ? (*_ifcurve)(0) : 0.f};
+}
+
+ColumnTablesKey Model::getColumnTablesKey(int width)
+{
+    return {width, _public_properties._crop_left, _public_properties._crop_right, _ifcurve->getFunction()->getParams()};
+}
+
+MappingKey Model::getMappingKey(int width, int height, bool alp)
+{
+    return {getRowTablesKey(height, alp), getColumnTablesKey(width), _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._tilt};
+}
+
+// refit the linear regression line and the isotropy table if the contour changed (crop top/bottom, smoothing)
+void Model::updateContour()
+{
+    if (_contour_stage.update(getContourKey()))
+    {
+        linearFit();
+        setupIsotropyTable();
+    }
+}
+
+// the rows and columns are taken from the row table and column integral stages, which only
+// recompute when their part of the parameters changed (e.g. crop left/right keeps the rows)
+void Model::setupMappingTables(int width, int height, MappingTables &mapping_tables, bool alp) // arc-length-parametrized (y uniformity)
+{
+    const std::vector<float> &if_curve_integrals = _column_tables.get(getColumnTablesKey(width), [&](std::vector<float> &integrals)
+                                                                      {
+        integrals.resize(width);
+        for (int w = 0; w < width; w++)
         {
-            mapping_tables._x_a_x[h] = getEFHeight(h_a);
+            float x = mix(float(_public_properties._crop_left), float(1 - _public_properties._crop_right), (double)w / (width - 1));
+            x = (x - 0.5) * 2; // map to [-1, 1]
+            integrals[w] = _ifcurve->getFunction()->integrate(0, abs(x));
+        } });
+
+    const RowTables &rows = _row_tables.get(getRowTablesKey(height, alp), [&](RowTables &tables)
+                                            {
+        tables.x_a_x.resize(height);
+        tables.a_x_y.resize(height);
+        tables.linear_fit.resize(height);
+
+        // the rows ascend in height, so every spline is evaluated in one pass over its knots
+        std::vector<float> h_a(height);
+        for (int h = 0; h < height; h++)
+        {
+            float y = (float)h / (height - 1);
+            h_a[h] = alp ? _a_x_bounds.interp(y) : _x_bounds.interp(y);
         }
-        else
+        if (!alp)
         {
-            mapping_tables._x_a_x[h] = h_a;
+            _x_a_x_cubic.evaluate(h_a.data(), height, h_a.data());
         }
-    }
+        _a_x_y_cubic.evaluate(h_a.data(), height, tables.a_x_y.data());
+
+        float if_0 = (*_ifcurve)(0);
+        for (int h = 0; h < height; h++)
+        {
+            tables.linear_fit[h] = _slope * h_a[h] + _intercept;
+
+            if (_public_properties._enforce_isotropy) // modify h_a based on the x-error at x=0 and height h
+            {
+                tables.x_a_x[h] = getEFHeight(h_a[h], if_0);
+            }
+            else
+            {
+                tables.x_a_x[h] = h_a[h];
+            }
+        } });
+
+    std::copy(if_curve_integrals.begin(), if_curve_integrals.end(), mapping_tables._if_curve_integrals);
+    std::copy(rows.x_a_x.begin(), rows.x_a_x.end(), mapping_tables._x_a_x);
+    std::copy(rows.a_x_y.begin(), rows.a_x_y.end(), mapping_tables._a_x_y);
+    std::copy(rows.linear_fit.begin(), rows.linear_fit.end(), mapping_tables._linear_fit);
 }
 
 // modified version of the standard mapping table to include an extra jittered values for each point in both directions
@@ -175,6 +301,12 @@ void Model::setupMappingTables(int width, int height, MappingTables &mapping_tab
 // !!!!! requires mapping tables 2 times the size !!!!!
 void Model::setupErrorMappingTables(int width, int height, MappingTables &mapping_tables)
 {
+    setupErrorMappingTables(width, height, mapping_tables, *_ifcurve);
+}
+
+void Model::setupErrorMappingTables(int width, int height, MappingTables &mapping_tables, IFCurve &ifcurve)
+{
+    float if_0 = ifcurve(0);
     for (int w = 0; w < width; w++)
     {
         int index_center = w * 2;
@@ -183,30 +315,41 @@ void Model::setupErrorMappingTables(int width, int height, MappingTables &mappin
         x_center = (x_center - 0.5) * 2; // map to [-1, 1]
         float x_jittered = x_center + (x_center < 0 ? JITTER : -JITTER);
 
-        mapping_tables._if_curve_integrals[index_center] = _ifcurve->getFunction()->integrate(0, abs(x_center));
-        mapping_tables._if_curve_integrals[index_center + 1] = _ifcurve->getFunction()->integrate(0, abs(x_jittered));
+        mapping_tables._if_curve_integrals[index_center] = ifcurve.getFunction()->integrate(0, abs(x_center));
+        mapping_tables._if_curve_integrals[index_center + 1] = ifcurve.getFunction()->integrate(0, abs(x_jittered));
     }
 
+    std::vector<float> h_a_centers(height), h_a_bottoms(height), r_centers(height), r_bottoms(height);
     for (int h = 0; h < height; h++)
     {
-        int index_center = h * 2;
-
         float y = (float)h / (height - 1);
-        float h_z = _x_bounds.interp(y);
+        h_a_centers[h] = _x_bounds.interp(y);
+    }
+    _x_a_x_cubic.evaluate(h_a_centers.data(), height, h_a_centers.data());
+    for (int h = 0; h < height; h++)
+    {
+        h_a_bottoms[h] = h_a_centers[h] + JITTER * _arc_length;
+    }
+    _a_x_y_cubic.evaluate(h_a_centers.data(), height, r_centers.data());
+    _a_x_y_cubic.evaluate(h_a_bottoms.data(), height, r_bottoms.data());
+
+    for (int h = 0; h < height; h++)
+    {
+        int index_center = h * 2;
 
-        float h_a_center = alglib::spline1dcalc(_x_a_x_spline, h_z);
-        float h_a_bottom = h_a_center + JITTER * _arc_length;
+        float h_a_center = h_a_centers[h];
+        float h_a_bottom = h_a_bottoms[h];
 
-        mapping_tables._a_x_y[index_center] = alglib::spline1dcalc(_a_x_y_spline, h_a_center);
+        mapping_tables._a_x_y[index_center] = r_centers[h];
         mapping_tables._linear_fit[index_center] = _slope * h_a_center + _intercept;
 
-        mapping_tables._a_x_y[index_center + 1] = alglib::spline1dcalc(_a_x_y_spline, h_a_bottom);
+        mapping_tables._a_x_y[index_center + 1] = r_bottoms[h];
         mapping_tables._linear_fit[index_center + 1] = _slope * h_a_bottom + _intercept;
 
         if (_public_properties._enforce_isotropy) // modify h_a based on the x-error at x=0 and height h
         {
-            mapping_tables._x_a_x[index_center] = getEFHeight(h_a_center);
-            mapping_tables._x_a_x[index_center + 1] = getEFHeight(h_a_bottom);
+            mapping_tables._x_a_x[index_center] = getEFHeight(h_a_center, if_0);
+            mapping_tables._x_a_x[index_center + 1] = getEFHeight(h_a_bottom, if_0);
         }
         else
         {
@@ -216,6 +359,113 @@ void Model::setupErrorMappingTables(int width, int height, MappingTables &mappin
     }
 }
 
+// mapping tables for ErrorMapper in ERROR_MODE_ANALYTIC (not doubled, no jittered entries)
+// additionally stores the derivatives with respect to x and h_a needed for the Jacobian
+// !!!!! requires mapping tables created with derivatives = true !!!!!
+void Model::setupAnalyticErrorMappingTables(int width, int height, MappingTables &mapping_tables)
+{
+    setupAnalyticErrorMappingTables(width, height, mapping_tables, *_ifcurve);
+}
+
+void Model::setupAnalyticErrorMappingTables(int width, int height, MappingTables &mapping_tables, IFCurve &ifcurve)
+{
+    IFCurveFunction *function = ifcurve.getFunction();
+    for (int w = 0; w < width; w++)
+    {
+        float x = mix(float(_public_properties._crop_left), float(1 - _public_properties._crop_right), (double)w / (width - 1));
+        x = (x - 0.5) * 2; // map to [-1, 1]
+        mapping_tables._if_curve_integrals[w] = function->integrate(0, abs(x));
+        mapping_tables._if_curve_values[w] = (*function)(abs(x));
+    }
+
+    float if_0 = ifcurve(0);
+    mapping_tables._d_linear_fit = _slope;
+    std::vector<float> h_as(height);
+    for (int h = 0; h < height; h++)
+    {
+        float y = (float)h / (height - 1);
+        h_as[h] = _x_bounds.interp(y);
+    }
+    _x_a_x_cubic.evaluate(h_as.data(), height, h_as.data());
+    _a_x_y_cubic.evaluate(h_as.data(), height, mapping_tables._a_x_y, mapping_tables._d_a_x_y);
+
+    for (int h = 0; h < height; h++)
+    {
+        float h_a = h_as[h];
+        mapping_tables._linear_fit[h] = _slope * h_a + _intercept;
+
+        if (_public_properties._enforce_isotropy) // d getEFHeight / d h_a is the integrand
+        {
+            mapping_tables._x_a_x[h] = getEFHeight(h_a, if_0);
+            mapping_tables._d_x_a_x[h] = getXDistortion(h_a, if_0);
+        }
+        else
+        {
+            mapping_tables._x_a_x[h] = h_a;
+            mapping_tables._d_x_a_x[h] = 1;
+        }
+    }
+}
+
+// derivatives of the parameter dependent entries of the jittered error mapping tables
+// (setupErrorMappingTables has to be called with the same ifcurve first)
+// interpolation_factor, d_value: the IF curve parameters as Dual, carrying the derivatives with respect to the optimized parameters
+void Model::setupErrorMappingTableGradients(int width, int height, MappingTables &mapping_tables, IFCurve &ifcurve, const Dual &interpolation_factor, const Dual &d_value, MappingTableGradients &gradients)
+{
+    IFCurveFunction *function = ifcurve.getFunction();
+    gradients._if_curve_integrals.resize(width * 2);
+    gradients._x_a_x.resize(height * 2);
+
+    for (int w = 0; w < width; w++)
+    {
+        int index_center = w * 2;
+
+        float x_center = mix(float(_public_properties._crop_left), float(1 - _public_properties._crop_right), (double)w / (width - 1));
+        x_center = (x_center - 0.5) * 2; // map to [-1, 1]
+        float x_jittered = x_center + (x_center < 0 ? JITTER : -JITTER);
+
+        // the values stay the ones of the tables, only the derivatives are taken from the Dual evaluation
+        Dual area_center = function->integrate(0, abs(x_center), d_value, interpolation_factor);
+        Dual area_jittered = function->integrate(0, abs(x_jittered), d_value, interpolation_factor);
+        area_center.v = mapping_tables._if_curve_integrals[index_center];
+        area_jittered.v = mapping_tables._if_curve_integrals[index_center + 1];
+        gradients._if_curve_integrals[index_center] = area_center;
+        gradients._if_curve_integrals[index_center + 1] = area_jittered;
+    }
+
+    Dual if_0 = (*function)(0, d_value, interpolation_factor);
+    std::vector<float> h_a_centers;
+    if (_public_properties._enforce_isotropy)
+    {
+        h_a_centers.resize(height);
+        for (int h = 0; h < height; h++)
+        {
+            float y = (float)h / (height - 1);
+            h_a_centers[h] = _x_bounds.interp(y);
+        }
+        _x_a_x_cubic.evaluate(h_a_centers.data(), height, h_a_centers.data());
+    }
+
+    for (int h = 0; h < height; h++)
+    {
+        int index_center = h * 2;
+
+        if (_public_properties._enforce_isotropy) // the EF height depends on the IF curve through if_0
+        {
+            float h_a_center = h_a_centers[h];
+            float h_a_bottom = h_a_center + JITTER * _arc_length;
+
+            gradients._x_a_x[index_center] = if_0.chain(mapping_tables._x_a_x[index_center], getEFHeightDerivative(h_a_center));
+            gradients._x_a_x[index_center + 1] = if_0.chain(mapping_tables._x_a_x[index_center + 1], getEFHeightDerivative(h_a_bottom));
+        }
+        else
+        {
+            gradients._x_a_x[index_center] = Dual(mapping_tables._x_a_x[index_center]);
+            gradients._x_a_x[index_center + 1] = Dual(mapping_tables._x_a_x[index_center + 1]);
+        }
+    }
+}
+
 void Model::registerObservers()
 {
     _public_properties._interpolation_factor.on_change([this](const float interpolation_factor)
@@ -244,21 +494,7 @@ void Model::updateState()
     bool optimize_aerror_weight_c = _public_properties._opt_aerror_weight.hasChanged();
     bool optimize_interpolation_factor_c = _public_properties._optimize_interpolation_factor.hasChanged();
     bool optimize_d_factor_c = _public_properties._optimize_d_factor.hasChanged();
-    bool optimize_radius_modifier_c = _public_properties._optimize_radius_modifier.hasChanged();
     bool preview_image_scale_c = _public_properties._preview_image_scale.hasChanged();
-    bool image_rotation_c = _public_properties._image_rotation.hasChanged();
-    bool vertical_shift_c = _public_properties._vertical_shift.hasChanged();
-    bool grid_x_c = _public_properties._grid_x.hasChanged();
-    bool grid_y_c = _public_properties._grid_y.hasChanged();
-    bool grid_active_c = _public_properties._grid_active.hasChanged();
-    bool grid_alp_c = _public_properties._grid_alp.hasChanged();
-    bool grid_thickness_c = _public_properties._grid_thickness.hasChanged();
-    bool image_active_c = _public_properties._image_active.hasChanged();
-    bool generate_error_maps_c = _public_properties._generate_error_maps.hasChanged();
-    bool error_map_quality_c = _public_properties._error_map_quality.hasChanged();
-    bool errors_use_gpu_c = _public_properties._errors_use_gpu.hasChanged();
-    bool plot_interpolation_c = _public_properties._plot_interpolation.hasChanged();
-    bool plot_ifcurve_c = _public_properties._plot_ifcurve.hasChanged();
     bool crop_bottom_c = _public_properties._crop_bottom.hasChanged();
     bool crop_top_c = _public_properties._crop_top.hasChanged();
     bool crop_left_c = _public_properties._crop_left.hasChanged();
@@ -270,20 +506,13 @@ void Model::updateState()
     bool spline_smoothing_c = _public_properties._spline_smoothing.hasChanged();
     bool render_max_res_c = _public_properties._render_max_res.hasChanged();
 
-    // set remap flags based on changed properties
-    bool remap_all_required = interp_factor_c || d_factor_c || d_restrict_c || radius_modifier_c || optimize_active_c || optimize_max_iterations_c || optimize_xerror_weight_c || optimize_yerror_weight_c || optimize_rerror_weight_c || optimize_aerror_weight_c || optimize_interpolation_factor_c || optimize_d_factor_c || tilt_c || preview_image_scale_c || crop_bottom_c || crop_top_c || crop_left_c || crop_right_c || enforce_isotropy_c || spline_smoothing_c || render_max_res_c;
+    // the outputs of the pipeline stages are keyed by their inputs and recompute on their own,
+    // the flags below only trigger the parameter optimization and the beta_U bounds
+    bool optimization_required = interp_factor_c || d_factor_c || d_restrict_c || radius_modifier_c || optimize_active_c || optimize_max_iterations_c || optimize_xerror_weight_c || optimize_yerror_weight_c || optimize_rerror_weight_c || optimize_aerror_weight_c || optimize_interpolation_factor_c || optimize_d_factor_c || tilt_c || preview_image_scale_c || crop_bottom_c || crop_top_c || crop_left_c || crop_right_c || enforce_isotropy_c || spline_smoothing_c || render_max_res_c;
 
     bool d_value_update_required = interp_factor_c || crop_top_c || crop_bottom_c || d_restrict_c;
 
-    _remap_image = remap_all_required || image_rotation_c || vertical_shift_c;
-    _remap_grid = remap_all_required || grid_x_c || grid_y_c || grid_thickness_c || grid_alp_c || grid_active_c;
-    _remap_errors = remap_all_required || error_map_quality_c || errors_use_gpu_c || generate_error_maps_c;
-
-    // refit linear regression line if crop parameters have changed
-    if (crop_bottom_c || crop_top_c)
-    {
-        linearFit();
-    }
+    updateContour();
 
     // update beta_U bounds - appendix A in the paper
     if (d_value_update_required)
@@ -291,53 +520,92 @@ void Model::updateState()
         updateBetaBounds();
     }
 
-    if (remap_all_required && _public_properties._optimize_active &&
+    if (optimization_required && _public_properties._optimize_active &&
         (_public_properties._optimize_interpolation_factor || _public_properties._optimize_d_factor || _public_properties._optimize_radius_modifier))
     {
-        optimizeParameters();
+        if (_defer_optimization)
+            _optimization_pending = true;
+        else
+            optimizeParameters();
     }
 }
 
 // update beta_U bounds - appendix A in the paper
 void Model::updateBetaBounds()
+{
+    float global_min, global_max;
+    getDBounds(_public_properties._interpolation_factor, global_min, global_max);
+
+    _ifcurve->setDBounds(global_min, global_max);
+    _parameter_feedback["D_LOW"] = global_min;
+    _parameter_feedback["D_HIGH"] = global_max;
+}
+
+// conservative bounds for the d-value of the IF curve with the given interpolation factor (only reads the model)
+// lower_slope, upper_slope (optional): derivatives of the bounds with respect to the interpolation factor
+void Model::getDBounds(float interpolation_factor, float &lower_bound, float &upper_bound, float *lower_slope, float *upper_slope)
 {
     int samples = int((float)_image_height * _public_properties._preview_image_scale * (1 - (_public_properties._crop_top + _public_properties._crop_bottom)));
     float global_min = -INFINITY;
     float global_max = INFINITY;
+    float global_min_slope = 0;
+    float global_max_slope = 0;
+    std::vector<float> h_as(std::max(samples, 0)), r_contours(std::max(samples, 0));
     for (int h = 0; h < samples; h++)
     {
         float y = (float)h / (samples - 1);
-        float h_z = _x_bounds.interp(y);
-        float h_a = alglib::spline1dcalc(_x_a_x_spline, h_z);
+        h_as[h] = _x_bounds.interp(y);
+    }
+    _x_a_x_cubic.evaluate(h_as.data(), samples, h_as.data());
+    _a_x_y_cubic.evaluate(h_as.data(), samples, r_contours.data());
+
+    for (int h = 0; h < samples; h++)
+    {
+        float h_a = h_as[h];
 
-        float b0 = -(_slope * h_a + _intercept) / (alglib::spline1dcalc(_a_x_y_spline, h_a) - (_slope * h_a + _intercept));
-        float b1 = (3 * _public_properties._interpolation_factor) / 2 + ((_slope * h_a + _intercept) / (2 * (alglib::spline1dcalc(_a_x_y_spline, h_a) - (_slope * h_a + _intercept))));
+        float b0 = -(_slope * h_a + _intercept) / (r_contours[h] - (_slope * h_a + _intercept));
+        float b1 = (3 * interpolation_factor) / 2 + ((_slope * h_a + _intercept) / (2 * (r_contours[h] - (_slope * h_a + _intercept))));
 
         float upper = b0 > b1 ? b0 : b1;
         float lower = b0 < b1 ? b0 : b1;
+        float upper_s = b0 > b1 ? 0 : 1.5f; // b1 grows with 3/2 * IF, b0 is constant
+        float lower_s = b0 < b1 ? 0 : 1.5f;
 
         // additionally restrict to 0 <= A_IF(1), AF_(0) <= 1
         if (_public_properties._d_restrict)
         {
-            float b0_restricted = std::max(0.0f, (3 * _public_properties._interpolation_factor - 1) / 2);
-            float b1_restricted = std::min(1.0f, (3 * _public_properties._interpolation_factor) / 2);
-
-            lower = std::max(lower, b0_restricted);
-            upper = std::min(upper, b1_restricted);
+            float b0_restricted = std::max(0.0f, (3 * interpolation_factor - 1) / 2);
+            float b1_restricted = std::min(1.0f, (3 * interpolation_factor) / 2);
+
+            if (b0_restricted > lower)
+            {
+                lower = b0_restricted;
+                lower_s = b0_restricted > 0 ? 1.5f : 0;
+            }
+            if (b1_restricted < upper)
+            {
+                upper = b1_restricted;
+                upper_s = b1_restricted < 1 ? 1.5f : 0;
+            }
         }
 
         if (global_min < lower)
         {
             global_min = lower;
+            global_min_slope = lower_s;
         }
         if (global_max > upper)
         {
             global_max = upper;
+            global_max_slope = upper_s;
         }
     }
-    _ifcurve->setDBounds(global_min, global_max);
-    _parameter_feedback["D_LOW"] = global_min;
-    _parameter_feedback["D_HIGH"] = global_max;
+    lower_bound = global_min;
+    upper_bound = global_max;
+    if (lower_slope != nullptr)
+        *lower_slope = global_min_slope;
+    if (upper_slope != nullptr)
+        *upper_slope = global_max_slope;
 }
 
 // check if specific properties are invalid before running calculations
@@ -363,8 +631,62 @@ RenderResult Model::renderImage()
     int width = int((float)_image_width * _public_properties._preview_image_scale * (1 - (_public_properties._crop_left + _public_properties._crop_right)));
     int height = int((float)_image_height * _public_properties._preview_image_scale * (1 - (_public_properties._crop_top + _public_properties._crop_bottom)));
 
+    if (_public_properties._render_warp)
+    {
+        MappingTables image_mapping_tables(width, height);
+        setupMappingTables(width, height, image_mapping_tables);
+        return _cpu_image_mapper->warp(*_cpu_renderer, _public_properties._render_max_res, width, height, image_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._image_rotation, _public_properties._vertical_shift, _public_properties._tilt, _public_properties._crop_bottom, _public_properties._crop_top, _public_properties._crop_left, _public_properties._crop_right);
+    }
+
+    if (_public_properties._render_textured || _public_properties._render_adaptive)
+    {
+        // the mesh only has to follow the mapping, the detail comes from the texture
+        int mesh_width, mesh_height;
+        RenderData render_data;
+        GridTexCoords tex_coords;
+        std::vector<float> tex_u, tex_v;
+        if (_public_properties._render_adaptive)
+        {
+            // only the columns and rows of the mapping the tolerance needs (always on the CPU)
+            ImageMapKey key = {getMappingKey(width, height), IMAGE_STAGE_ADAPTIVE, _public_properties._image_rotation, _public_properties._vertical_shift,
+                               true, false, _public_properties._render_max_res, _public_properties._adaptive_tolerance};
+            if (_image_stage.update(key))
+            {
+                MappingTables image_mapping_tables(width, height);
+                setupMappingTables(width, height, image_mapping_tables);
+                _cpu_image_mapper->tessellate(_public_properties._render_max_res, _public_properties._adaptive_tolerance, width, height, image_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._image_rotation, _public_properties._vertical_shift, _public_properties._tilt, _public_properties._crop_bottom, _public_properties._crop_top, _public_properties._crop_left, _public_properties._crop_right);
+            }
+            AdaptiveMesh &mesh = _cpu_image_mapper->_mesh;
+            mesh_width = mesh._width;
+            mesh_height = mesh._height;
+            render_data = mesh.getRenderData();
+            tex_coords = mesh.getTexCoords();
+        }
+        else
+        {
+            int step = std::max(1, (int)_public_properties._texture_mesh_step);
+            mesh_width = std::max(2, width / step);
+            mesh_height = std::max(2, height / step);
+            mapImage(mesh_width, mesh_height);
+            render_data = (_public_properties._map_use_cpu ? _cpu_image_mapper->_result : _image_mapper->_result)->getRenderData();
+            getImageTexCoords(mesh_width, mesh_height, tex_u, tex_v);
+            tex_coords = {tex_u.data(), tex_v.data()};
+        }
+
+        if (_public_properties._render_use_cpu)
+        {
+            return _cpu_renderer->renderTexturedTriangles(mesh_width, mesh_height, _public_properties._render_max_res, render_data, tex_coords, _image, _image_width, _image_height);
+        }
+        return getRenderer()->renderTexturedTriangles(mesh_width, mesh_height, _public_properties._render_max_res, render_data, tex_coords, getImageMapper()->_image_tex);
+    }
+
     mapImage(width, height);
-    return _renderer->renderTriangles(width, height, _public_properties._render_max_res, _image_mapper->_result->getRenderData());
+    if (renderResident())
+    {
+        return getRenderer()->renderMapped(width, height, _public_properties._render_max_res, _image_mapper->_buffers[0], _image_mapper->_buffers[1], _image_mapper->_buffers[2]);
+    }
+    ImageMapResult *result = _public_properties._map_use_cpu ? _cpu_image_mapper->_result : _image_mapper->_result;
+    return renderTriangles(width, height, result->getRenderData());
 }
 
 #define ERROR_DIMS 500.f
@@ -376,132 +698,449 @@ RenderResult Model::renderError(int error_type)
     switch (error_type)
     {
     case 0:
-        return _renderer->renderTriangles(width, height, _public_properties._render_max_res, _error_mapper->_result->getRenderDataXError());
+        return renderTriangles(width, height, _error_mapper->_result->getRenderDataXError());
         break;
     case 1:
-        return _renderer->renderTriangles(width, height, _public_properties._render_max_res, _error_mapper->_result->getRenderDataYError());
+        return renderTriangles(width, height, _error_mapper->_result->getRenderDataYError());
         break;
     case 2:
-        return _renderer->renderTriangles(width, height, _public_properties._render_max_res, _error_mapper->_result->getRenderDataXYError());
+        return renderTriangles(width, height, _error_mapper->_result->getRenderDataXYError());
         break;
     case 3:
-        return _renderer->renderTriangles(width, height, _public_properties._render_max_res, _error_mapper->_result->getRenderDataRError());
+        return renderTriangles(width, height, _error_mapper->_result->getRenderDataRError());
         break;
     case 4:
-        return _renderer->renderTriangles(width, height, _public_properties._render_max_res, _error_mapper->_result->getRenderDataAError());
+        return renderTriangles(width, height, _error_mapper->_result->getRenderDataAError());
         break;
     default:
         assert(false);
     }
 }
 
+bool Model::exportImage(const std::string &path, int render_size)
+{
+    if (_image == nullptr || !checkPropertiesValid())
+        return false;
+
+    // the preview scale only applies to the interactive renders
+    int width = int((float)_image_width * (1 - (_public_properties._crop_left + _public_properties._crop_right)));
+    int height = int((float)_image_height * (1 - (_public_properties._crop_top + _public_properties._crop_bottom)));
+    MappingTables image_mapping_tables(width, height);
+    setupMappingTables(width, height, image_mapping_tables);
+
+    // the image is at most render_size wide
+    int band_height = std::max(1, EXPORT_BAND_BYTES / (std::max(render_size, 1) * CHANNELS));
+
+    PNGStreamWriter writer;
+    bool written = true;
+    _cpu_image_mapper->warpBands(render_size, band_height, width, height, image_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier,
+                                 _public_properties._image_rotation, _public_properties._vertical_shift, _public_properties._tilt, _public_properties._crop_bottom, _public_properties._crop_top, _public_properties._crop_left, _public_properties._crop_right,
+                                 [&](const RenderResult &band, int band_begin, int image_height)
+                                 {
+                                     if (band_begin == 0)
+                                         written = writer.open(path, int(band.width), image_height);
+                                     written = written && writer.writeRows(band.image, int(band.height));
+                                     return written;
+                                 });
+    return writer.close() && written;
+}
+
+std::vector<const StageCounters *> Model::getStages() const
+{
+    return {&_contour_stage, &_row_tables, &_column_tables, &_image_stage, &_grid_stage, &_error_stage};
+}
+
+std::string Model::getStageStatistics() const
+{
+    std::string statistics;
+    for (const StageCounters *stage : getStages())
+    {
+        statistics += stage->toString() + "\n";
+    }
+    return statistics;
+}
+
 RenderResult Model::renderGrid()
 {
     mapGrid(_public_properties._grid_x, _public_properties._grid_y);
 
-    return _renderer->renderLines(_public_properties._grid_x, _public_properties._grid_y, _grid_mapper->_result->_r_x.size(), _grid_mapper->_result->_r_l.size(),
-                                  _public_properties._render_max_res, _public_properties._image_active,
-                                  _public_properties._grid_thickness, _grid_mapper->_result->getRenderData());
+    return renderLines(_grid_mapper->_result->_r_x.size(), _grid_mapper->_result->_r_l.size(), _grid_mapper->_result->getRenderData());
+}
+
+RenderResult Model::renderTriangles(int width, int height, RenderData render_data)
+{
+    if (_public_properties._render_use_cpu)
+    {
+        return _cpu_renderer->renderTriangles(width, height, _public_properties._render_max_res, render_data);
+    }
+    return getRenderer()->renderTriangles(width, height, _public_properties._render_max_res, render_data);
+}
+
+RenderResult Model::renderLines(int num_points, int num_indices, RenderData render_data)
+{
+    // the grid is drawn on top of the image if it is active (the warped image is always in the software renderer)
+    if (_public_properties._render_use_cpu || _public_properties._render_warp)
+    {
+        return _cpu_renderer->renderLines(_public_properties._grid_x, _public_properties._grid_y, num_points, num_indices,
+                                          _public_properties._render_max_res, _public_properties._image_active,
+                                          _public_properties._grid_thickness, render_data);
+    }
+    return getRenderer()->renderLines(_public_properties._grid_x, _public_properties._grid_y, num_points, num_indices,
+                                      _public_properties._render_max_res, _public_properties._image_active,
+                                      _public_properties._grid_thickness, render_data);
+}
+
+bool Model::renderResident()
+{
+    return _public_properties._render_resident && !_public_properties._render_textured && !_public_properties._render_adaptive && !_public_properties._map_use_cpu && !_public_properties._render_use_cpu;
+}
+
+bool Model::usesGPU()
+{
+    // the error maps go through renderTriangles, the warp and the adaptive mesh are always mapped on the CPU
+    return !_public_properties._render_use_cpu || (!_public_properties._map_use_cpu && !_public_properties._render_warp && !_public_properties._render_adaptive);
+}
+
+ImageMapper *Model::getImageMapper()
+{
+    if (_image_mapper == nullptr)
+    {
+        _image_mapper = new ImageMapper();
+    }
+    if (!_image_texture_loaded && _image != nullptr)
+    {
+        _image_mapper->loadImageTexture(_image_width, _image_height, _image);
+        _image_texture_loaded = true;
+    }
+    return _image_mapper;
+}
+
+Renderer *Model::getRenderer()
+{
+    if (_renderer == nullptr)
+    {
+        _renderer = new Renderer();
+    }
+    return _renderer;
+}
+
+void Model::getImageTexCoords(int width, int height, std::vector<float> &u, std::vector<float> &v)
+{
+    // only the texture coordinate part of the parameters is used
+    ImageKernelParams params = {width, height, 0.f, 0.f, 0.f, 0.f,
+                                _public_properties._image_rotation, _public_properties._vertical_shift,
+                                _public_properties._crop_bottom, _public_properties._crop_top, _public_properties._crop_left, _public_properties._crop_right,
+                                nullptr, nullptr, nullptr, nullptr, nullptr, 0, 0};
+
+    u.resize(width);
+    v.resize(height);
+    for (int xi = 0; xi < width; xi++)
+    {
+        u[xi] = getImageTexX(params, float(xi));
+    }
+    for (int yi = 0; yi < height; yi++)
+    {
+        v[yi] = getImageTexY(params, float(yi));
+    }
 }
 
 void Model::mapImage(int width, int height)
 {
-    if (_remap_image)
+    // the textured mesh gets rotation and shift through its texture coordinates
+    bool textured = _public_properties._render_textured;
+    ImageMapKey key = {getMappingKey(width, height), textured ? IMAGE_STAGE_TEXTURED : IMAGE_STAGE_MESH,
+                       textured ? 0.f : float(_public_properties._image_rotation), textured ? 0.f : float(_public_properties._vertical_shift),
+                       _public_properties._map_use_cpu, renderResident(), 0, 0.f};
+    if (_image_stage.update(key))
     {
         MappingTables image_mapping_tables(width, height);
         setupMappingTables(width, height, image_mapping_tables);
-        _image_mapper->map(width, height, image_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._image_rotation, _public_properties._vertical_shift, _public_properties._tilt, _public_properties._crop_bottom, _public_properties._crop_top, _public_properties._crop_left, _public_properties._crop_right);
+        if (_public_properties._map_use_cpu)
+            _cpu_image_mapper->map(width, height, image_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._image_rotation, _public_properties._vertical_shift, _public_properties._tilt, _public_properties._crop_bottom, _public_properties._crop_top, _public_properties._crop_left, _public_properties._crop_right);
+        else
+        {
+            ImageMapper *image_mapper = getImageMapper();
+            image_mapper->setKeepOnGPU(renderResident());
+            image_mapper->map(width, height, image_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._image_rotation, _public_properties._vertical_shift, _public_properties._tilt, _public_properties._crop_bottom, _public_properties._crop_top, _public_properties._crop_left, _public_properties._crop_right);
+        }
     }
-    _remap_image = false;
 }
 
 void Model::mapGrid(int width, int height)
 {
-    if (_remap_grid)
+    bool alp = _public_properties._grid_alp;
+    if (_grid_stage.update({getMappingKey(GRID_SUBDIVISIONS, height, alp), getMappingKey(width, GRID_SUBDIVISIONS, alp)}))
     {
-        MappingTables grid_mapping_tables(width, height);
-        setupMappingTables(width, height, grid_mapping_tables, _public_properties._grid_alp);
-        _grid_mapper->map(width, height, grid_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._tilt, _public_properties._crop_left, _public_properties._crop_right);
-        _grid_mapper->interpolate();
+        // the lines are sampled GRID_SUBDIVISIONS times along their own direction
+        MappingTables horizontal_tables(GRID_SUBDIVISIONS, height);
+        MappingTables vertical_tables(width, GRID_SUBDIVISIONS);
+        setupMappingTables(GRID_SUBDIVISIONS, height, horizontal_tables, _public_properties._grid_alp);
+        setupMappingTables(width, GRID_SUBDIVISIONS, vertical_tables, _public_properties._grid_alp);
+        _grid_mapper->map(width, height, horizontal_tables, vertical_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._tilt, _public_properties._crop_left, _public_properties._crop_right);
     }
-    _remap_grid = false;
 }
 
 void Model::mapErrors()
 {
-    if (_remap_errors)
+    ErrorMapKey key = {getContourKey(), _ifcurve->getFunction()->getParams(), _public_properties._crop_left, _public_properties._crop_right,
+                       _public_properties._enforce_isotropy, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._tilt,
+                       _public_properties._error_map_quality, _public_properties._errors_use_gpu, _public_properties._errors_vectorized, _public_properties._errors_analytic};
+    if (_error_stage.update(key))
     {
         int width = (int)(ERROR_DIMS * _public_properties._error_map_quality);
         int height = (int)(ERROR_DIMS * _public_properties._error_map_quality);
 
-        MappingTables error_mapping_tables(width * 2, height * 2);
-        setupErrorMappingTables(width, height, error_mapping_tables);
-        _error_mapper->map(width, height, &error_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._tilt, _public_properties._crop_left, _public_properties._crop_right);
+        _error_mapper->setVectorized(_public_properties._errors_vectorized);
+        if (_public_properties._errors_analytic)
+        {
+            MappingTables error_mapping_tables(width, height, true);
+            setupAnalyticErrorMappingTables(width, height, error_mapping_tables);
+            _error_mapper->setMode(ERROR_MODE_ANALYTIC);
+            _error_mapper->map(width, height, &error_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._tilt, _public_properties._crop_left, _public_properties._crop_right);
+        }
+        else
+        {
+            MappingTables error_mapping_tables(width * 2, height * 2);
+            setupErrorMappingTables(width, height, error_mapping_tables);
+            _error_mapper->setMode(ERROR_MODE_JITTER);
+            _error_mapper->map(width, height, &error_mapping_tables, _arc_length, _public_properties._interpolation_factor, _public_properties._radius_modifier, _public_properties._tilt, _public_properties._crop_left, _public_properties._crop_right);
+        }
+    }
+}
+
+#define SWEEP_SLABS_PER_THREAD 4 // slabs per thread between two output calls
+
+// error sums of every sweep point on the error map grid (same tables as mapErrors, but no map is written)
+// consecutive points with the same IF and d-value form a slab that shares one table setup. the slabs are
+// distributed over the shared thread pool in blocks, every slab on its own OptimizationState, and output
+// receives the sums of each block in point order (independent of the number of threads)
+void Model::sweepErrors(const std::vector<SweepPoint> &points, const SweepOutputCallback &output)
+{
+    int dims = (int)(ERROR_DIMS * _public_properties._error_map_quality);
+    bool analytic = _public_properties._errors_analytic;
+
+    std::vector<int> slab_begin;
+    for (int p = 0; p < int(points.size()); p++)
+    {
+        if (p == 0 || points[p].interpolation_factor != points[p - 1].interpolation_factor || points[p].d_value != points[p - 1].d_value)
+            slab_begin.push_back(p);
+    }
+    slab_begin.push_back(int(points.size()));
+    int slabs = int(slab_begin.size()) - 1;
+
+    ThreadPool &pool = ThreadPool::shared();
+    int block_slabs = pool.size() * SWEEP_SLABS_PER_THREAD;
+    std::vector<ErrorSums> sums;
+    for (int block_begin = 0; block_begin < slabs; block_begin += block_slabs)
+    {
+        int block_end = std::min(slabs, block_begin + block_slabs);
+        int first_point = slab_begin[block_begin];
+        sums.assign(slab_begin[block_end] - first_point, ErrorSums());
+
+        pool.parallelFor(block_begin, block_end, block_end - block_begin, [&](int, int slab, int)
+                         {
+            const SweepPoint &slab_point = points[slab_begin[slab]];
+            OptimizationState state(*_ifcurve, dims, analytic);
+            state._error_mapper.setParallel(false); // the slabs already run in parallel
+            state._error_mapper.setMode(analytic ? ERROR_MODE_ANALYTIC : ERROR_MODE_JITTER);
+            state._ifcurve.getFunction()->update(slab_point.d_value, slab_point.interpolation_factor);
+            if (analytic)
+                setupAnalyticErrorMappingTables(dims, dims, state._mapping_tables, state._ifcurve);
+            else
+                setupErrorMappingTables(dims, dims, state._mapping_tables, state._ifcurve);
+
+            for (int p = slab_begin[slab]; p < slab_begin[slab + 1]; p++)
+            {
+                sums[p - first_point] = state._error_mapper.reduce(dims, dims, &state._mapping_tables, _arc_length, points[p].interpolation_factor, points[p].radius_modifier, _public_properties._tilt, _public_properties._crop_left, _public_properties._crop_right);
+            } });
+
+        output(first_point, sums);
     }
-    _remap_errors = false;
 }
 
+// best evaluation of all local searches, evaluations on finer grids replace the coarser ones
+struct OptimizationProgress
+{
+    const std::atomic<bool> *cancelled = nullptr;
+    const OptimizationProgressCallback *callback = nullptr;
+    std::mutex mutex;
+    int level = -1;
+    double error = HUGE_VAL; // mean error per grid point
+    std::vector<double> x;
+    std::chrono::steady_clock::time_point last_report;
+
+    bool isCancelled() const
+    {
+        return cancelled != nullptr && cancelled->load();
+    }
+};
+
 struct ParamOptData
 {
     Model *_model;
-    MappingTables *_mapping_tables;
+    OptimizationState *_state;
     int if_index;
     int d_index;
     int rad_index;
+    int level;
+    OptimizationProgress *_progress;
 };
-#define OPTIMIZATION_DIMS 100
-void Model::optimizeParameters()
+
+#define OPTIMIZATION_PROGRESS_INTERVAL 0.1 // seconds between two progress callbacks
+
+// keeps track of the best evaluation and reports it to the progress callback
+static void recordEvaluation(ParamOptData *opt_data, const std::vector<double> &x, double error)
 {
-    MappingTables error_mapping_tables(OPTIMIZATION_DIMS * 2, OPTIMIZATION_DIMS * 2);
-    setupErrorMappingTables(OPTIMIZATION_DIMS, OPTIMIZATION_DIMS, error_mapping_tables);
-    auto objective = [](const std::vector<double> &x, std::vector<double> &grad, void *data) -> double
+    OptimizationProgress *progress = opt_data->_progress;
+    double mean_error = error / (opt_data->_state->_dims * opt_data->_state->_dims);
+
+    std::lock_guard<std::mutex> lock(progress->mutex);
+    if (opt_data->level < progress->level || (opt_data->level == progress->level && mean_error >= progress->error))
+        return;
+    progress->level = opt_data->level;
+    progress->error = mean_error;
+    progress->x = x;
+
+    auto now = std::chrono::steady_clock::now();
+    if (progress->callback == nullptr || !*progress->callback || std::chrono::duration<double>(now - progress->last_report).count() < OPTIMIZATION_PROGRESS_INTERVAL)
+        return;
+    progress->last_report = now;
+
+    boost::json::object feedback;
+    if (opt_data->_model->getModelPublicProperties()._optimize_interpolation_factor)
+        feedback["SET_INTERPOLATION_FACTOR"] = x[opt_data->if_index];
+    if (opt_data->_model->getModelPublicProperties()._optimize_d_factor)
+        feedback["SET_D_FACTOR"] = x[opt_data->d_index];
+    if (opt_data->_model->getModelPublicProperties()._optimize_radius_modifier)
+        feedback["SET_RADIUS_MODIFIER"] = x[opt_data->rad_index];
+    feedback["OPTIMIZATION_ERROR"] = mean_error;
+    feedback["OPTIMIZATION_LEVEL"] = opt_data->level;
+    (*progress->callback)(feedback);
+}
+
+// objective of a local search, only writes the state of its own start
+// with a non-empty grad (gradient based algorithms) the evaluation runs on dual numbers,
+// the partial derivatives are indexed like x
+static double evaluateParameters(const std::vector<double> &x, std::vector<double> &grad, void *data)
+{
+    ParamOptData *opt_data = static_cast<ParamOptData *>(data);
+    Model *m = opt_data->_model;
+    ModelPublicProperties &properties = m->getModelPublicProperties();
+    OptimizationState *state = opt_data->_state;
+
+    // ends the local search, nlopt rethrows it from optimize()
+    if (opt_data->_progress->isCancelled())
+        throw nlopt::forced_stop();
+
+    // determine values for IF, dFactor, radFactor based on optimization flags
+    float interpolation_factor = properties._interpolation_factor;
+    float d_factor = properties._d_factor;
+    float radius_modifier = properties._radius_modifier;
+    if (properties._optimize_interpolation_factor)
+    {
+        interpolation_factor = x[opt_data->if_index];
+    }
+    if (properties._optimize_d_factor)
+    {
+        d_factor = x[opt_data->d_index];
+    }
+    if (properties._optimize_radius_modifier)
     {
-        ParamOptData *opt_data = static_cast<ParamOptData *>(data);
-        Model *m = opt_data->_model;
-        MappingTables *mapping_tables = opt_data->_mapping_tables;
+        radius_modifier = x[opt_data->rad_index];
+    }
 
-        // determine values for IF, dFactor, radFactor based on optimization flags
-        // update the ifcurve if necessary
-        float interpolation_factor = m->_public_properties._interpolation_factor;
-        float d_factor = m->_public_properties._d_factor;
-        float radius_modifier = m->_public_properties._radius_modifier;
-        if (m->_public_properties._optimize_interpolation_factor)
-        {
-            interpolation_factor = x[opt_data->if_index];
-            m->_public_properties._interpolation_factor.setValue({float(interpolation_factor), true});
-            m->updateBetaBounds();
-        }
-        if (m->_public_properties._optimize_d_factor)
+    Dual interpolation_factor_dual = Dual::variable(interpolation_factor, properties._optimize_interpolation_factor ? opt_data->if_index : -1);
+    Dual d_factor_dual = Dual::variable(d_factor, properties._optimize_d_factor ? opt_data->d_index : -1);
+    Dual radius_modifier_dual = Dual::variable(radius_modifier, properties._optimize_radius_modifier ? opt_data->rad_index : -1);
+
+    // update the ifcurve and recompute mapping tables if necessary
+    if (properties._optimize_interpolation_factor || properties._optimize_d_factor)
+    {
+        float d_lower, d_upper, d_lower_slope = 0, d_upper_slope = 0;
+        state->_ifcurve.setInterpolationFactor(interpolation_factor);
+        if (properties._optimize_interpolation_factor)
         {
-            d_factor = x[opt_data->d_index];
-            m->_public_properties._d_factor.setValue({float(d_factor), true});
-            m->_ifcurve->setDFactor(d_factor);
+            m->getDBounds(interpolation_factor, d_lower, d_upper, &d_lower_slope, &d_upper_slope);
+            state->_ifcurve.setDBounds(d_lower, d_upper);
         }
-        if (m->_public_properties._optimize_radius_modifier)
+        else
         {
-            radius_modifier = x[opt_data->rad_index];
-            m->_public_properties._radius_modifier.setValue({float(radius_modifier), true});
+            state->_ifcurve.getDBounds(d_lower, d_upper);
         }
-        // recompute mapping tables if necessary
-        if (m->_public_properties._optimize_interpolation_factor || m->_public_properties._optimize_d_factor)
+        state->_ifcurve.setDFactor(d_factor);
+
+        if (properties._errors_analytic)
+            m->setupAnalyticErrorMappingTables(state->_dims, state->_dims, state->_mapping_tables, state->_ifcurve);
+        else
+            m->setupErrorMappingTables(state->_dims, state->_dims, state->_mapping_tables, state->_ifcurve);
+
+        if (!grad.empty())
         {
-            m->setupErrorMappingTables(OPTIMIZATION_DIMS, OPTIMIZATION_DIMS, *mapping_tables);
+            // d-value = lower + d_factor * (upper - lower), the bounds depend on IF
+            Dual lower = interpolation_factor_dual.chain(d_lower, d_lower_slope);
+            Dual upper = interpolation_factor_dual.chain(d_upper, d_upper_slope);
+            Dual d_value = lower + d_factor_dual * (upper - lower);
+            m->setupErrorMappingTableGradients(state->_dims, state->_dims, state->_mapping_tables, state->_ifcurve, interpolation_factor_dual, d_value, state->_gradients);
         }
+    }
 
-        m->_error_mapper->map(OPTIMIZATION_DIMS, OPTIMIZATION_DIMS, mapping_tables, m->_arc_length, interpolation_factor, radius_modifier, m->_public_properties._tilt, m->_public_properties._crop_left, m->_public_properties._crop_right);
-        double error = 0.0;
-        for (int i = 0; i < OPTIMIZATION_DIMS * OPTIMIZATION_DIMS; i++)
+    if (!grad.empty())
+    {
+        DualErrorSums sums = state->_error_mapper.reduceGradient(state->_dims, state->_dims, &state->_mapping_tables, &state->_gradients, m->getArcLength(), interpolation_factor_dual, radius_modifier_dual, properties._tilt, properties._crop_left, properties._crop_right);
+        Dual error = sums.weighted(properties._opt_xerror_weight, properties._opt_yerror_weight, properties._opt_rerror_weight, properties._opt_aerror_weight);
+        for (size_t i = 0; i < grad.size(); i++)
         {
-            error += m->_error_mapper->_result->getWeightedError(i, {m->_public_properties._opt_xerror_weight, m->_public_properties._opt_yerror_weight, m->_public_properties._opt_rerror_weight, m->_public_properties._opt_aerror_weight});
+            grad[i] = error.d[i];
         }
-        return error;
-    };
+        recordEvaluation(opt_data, x, error.v);
+        return error.v;
+    }
+
+    // only the error sums are needed, no error map is written
+    ErrorSums sums = state->_error_mapper.reduce(state->_dims, state->_dims, &state->_mapping_tables, m->getArcLength(), interpolation_factor, radius_modifier, properties._tilt, properties._crop_left, properties._crop_right);
+    double error = sums.weighted(properties._opt_xerror_weight, properties._opt_yerror_weight, properties._opt_rerror_weight, properties._opt_aerror_weight);
+    recordEvaluation(opt_data, x, error);
+    return error;
+}
+
+// i-th point of the halton sequence in dimension dim (bases 2, 3, 5)
+static double halton(int i, int dim)
+{
+    static const int bases[] = {2, 3, 5};
+    int base = bases[dim % 3];
+    double f = 1, r = 0;
+    for (; i > 0; i /= base)
+    {
+        f /= base;
+        r += f * (i % base);
+    }
+    return r;
+}
+
+// multi-start, multi-resolution local optimization
+// every local search runs BOBYQA (or a gradient based algorithm, see _opt_algorithm) on its own OptimizationState, the searches of a level are
+// distributed over the shared thread pool (ties go to the lower index, so the result does not
+// depend on the number of threads)
+//  - level 0: all starts on a coarse error grid (_opt_coarse_dims)
+//  - following levels: the best _opt_candidates are refined on finer grids up to _opt_final_dims
+// a cancelled optimization applies the best evaluation so far (from the finest level reached)
+#define OPTIMIZATION_STARTS 8
+#define OPTIMIZATION_MAX_TIME 10.0 // seconds for all levels together
+void Model::optimizeParameters(const std::atomic<bool> *cancelled, const OptimizationProgressCallback &progress_callback)
+{
+    bool analytic = _public_properties._errors_analytic;
+    // dual numbers are only implemented for the jittered errors, analytic errors fall back to BOBYQA
+    nlopt::algorithm algorithm = nlopt::LN_BOBYQA;
+    if (!analytic && _public_properties._opt_algorithm == OPT_ALGORITHM_LBFGS)
+        algorithm = nlopt::LD_LBFGS;
+    else if (!analytic && _public_properties._opt_algorithm == OPT_ALGORITHM_SLSQP)
+        algorithm = nlopt::LD_SLSQP;
+    bool gradient = algorithm != nlopt::LN_BOBYQA;
 
     int dimensions = _public_properties._optimize_interpolation_factor + _public_properties._optimize_d_factor + _public_properties._optimize_radius_modifier;
     std::vector<double> upper_bounds;
     std::vector<double> lower_bounds;
     std::vector<double> initial_values;
-    std::vector<double> x_tol;
 
     if (_public_properties._optimize_interpolation_factor)
     {
@@ -522,41 +1161,178 @@ void Model::optimizeParameters()
         lower_bounds.push_back(_slope < 0 ? -500 : 0.5);
         initial_values.push_back(_slope < 0 ? -M_PI : M_PI);
     }
+    if (dimensions == 0)
+        return;
 
     int index_of_if = -1 + _public_properties._optimize_interpolation_factor;
     int index_of_d = index_of_if + _public_properties._optimize_d_factor;
     int index_of_radius_modifier = index_of_d + _public_properties._optimize_radius_modifier;
-    ParamOptData optData = {this, &error_mapping_tables, index_of_if, index_of_d, index_of_radius_modifier};
 
-    nlopt::opt global(dimensions == 1 ? nlopt::GN_DIRECT : nlopt::GN_MLSL, dimensions);
-    global.set_min_objective(objective, (void *)&optData);
-    global.set_maxeval(_public_properties._optimize_max_iterations);
-    global.set_maxtime(10);
-    global.set_upper_bounds(upper_bounds);
-    global.set_lower_bounds(lower_bounds);
-    if (dimensions > 1)
+    // resolution schedule, the grid grows geometrically from the coarse to the final size
+    int final_dims = std::max(2, int(_public_properties._opt_final_dims));
+    int coarse_dims = std::clamp(int(_public_properties._opt_coarse_dims), 2, final_dims);
+    int levels = std::max(1, int(_public_properties._opt_levels));
+    int candidates = std::clamp(int(_public_properties._opt_candidates), 1, OPTIMIZATION_STARTS);
+    std::vector<int> level_dims(levels, final_dims);
+    for (int level = 0; level < levels - 1; level++)
     {
-        nlopt::opt local(nlopt::LN_BOBYQA, dimensions);
-        local.set_ftol_abs(1e-5);
-        global.set_local_optimizer(local);
+        level_dims[level] = int(std::round(coarse_dims * std::pow(double(final_dims) / coarse_dims, double(level) / (levels - 1))));
     }
-    else
+
+    // start 0 is the usual initial guess, the others are spread over the bounds
+    std::vector<std::vector<double>> points(OPTIMIZATION_STARTS, initial_values);
+    for (int s = 1; s < OPTIMIZATION_STARTS; s++)
     {
-        global.set_ftol_abs(1e-5);
+        for (int i = 0; i < dimensions; i++)
+        {
+            points[s][i] = lower_bounds[i] + halton(s, i) * (upper_bounds[i] - lower_bounds[i]);
+        }
     }
-    std::vector<double> x = initial_values;
 
-    double minf;
-    try
+    // the evaluation budget is split between all local searches (BOBYQA needs 2n+1 for its first model)
+    int num_searches = OPTIMIZATION_STARTS + (levels - 1) * candidates;
+    int max_evaluations = std::max(2 * dimensions + 2, int(_public_properties._optimize_max_iterations) / num_searches);
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    OptimizationProgress progress;
+    progress.cancelled = cancelled;
+    progress.callback = &progress_callback;
+    progress.last_report = start_time;
+
+    // one BOBYQA run from x on a dims x dims grid, returns the error (HUGE_VAL if there was no time left)
+    auto local_search = [&](std::vector<double> &x, int level) -> double
+    {
+        double remaining_time = OPTIMIZATION_MAX_TIME - std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        if (remaining_time <= 0 || progress.isCancelled())
+            return HUGE_VAL;
+
+        // analytic tables are not doubled, the jittered ones hold an extra entry per row and column
+        int dims = level_dims[level];
+        OptimizationState state(*_ifcurve, dims, analytic);
+        state._error_mapper.setParallel(false); // the searches already run in parallel
+        state._error_mapper.setMode(analytic ? ERROR_MODE_ANALYTIC : ERROR_MODE_JITTER);
+        if (analytic)
+            setupAnalyticErrorMappingTables(dims, dims, state._mapping_tables, state._ifcurve);
+        else
+            setupErrorMappingTables(dims, dims, state._mapping_tables, state._ifcurve);
+        if (gradient) // constant gradients if only the radius is optimized
+            setupErrorMappingTableGradients(dims, dims, state._mapping_tables, state._ifcurve, Dual(_public_properties._interpolation_factor), Dual(), state._gradients);
+
+        ParamOptData opt_data = {this, &state, index_of_if, index_of_d, index_of_radius_modifier, level, &progress};
+
+        nlopt::opt local(algorithm, dimensions);
+        local.set_min_objective(evaluateParameters, (void *)&opt_data);
+        local.set_maxeval(max_evaluations);
+        local.set_maxtime(remaining_time);
+        local.set_upper_bounds(upper_bounds);
+        local.set_lower_bounds(lower_bounds);
+        if (level == levels - 1)
+        {
+            local.set_ftol_abs(1e-5);
+        }
+        else
+        {
+            local.set_ftol_rel(1e-4); // only has to find the right basin
+        }
+        if (level > 0)
+        {
+            // refinements start close to a minimum, so the trust region starts small
+            std::vector<double> step(dimensions);
+            for (int i = 0; i < dimensions; i++)
+            {
+                step[i] = (upper_bounds[i] - lower_bounds[i]) * std::pow(0.25, level + 1);
+            }
+            local.set_initial_step(step);
+        }
+
+        double minf = HUGE_VAL;
+        try
+        {
+            local.optimize(x, minf);
+        }
+        catch (const nlopt::roundoff_limited &)
+        {
+            // not an error, x and minf hold the best point found
+        }
+        catch (const nlopt::forced_stop &)
+        {
+            // cancelled, the best point is kept in progress
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Optimizer crashed with error: " << e.what() << '\n';
+        }
+        return minf;
+    };
+
+    // with a complete error landscape its minima replace the global search, only the final level polishes them
+    int first_level = 0;
+    if (_public_properties._opt_landscape && _landscape.matches(getLandscapeKey()) && _landscape.isComplete() &&
+        (_public_properties._optimize_radius_modifier || _landscape.containsRad(_public_properties._radius_modifier)))
     {
-        nlopt::result result = global.optimize(x, minf);
+        bool optimized[3] = {_public_properties._optimize_interpolation_factor, _public_properties._optimize_d_factor, _public_properties._optimize_radius_modifier};
+        LandscapePoint fixed = {_public_properties._interpolation_factor, _public_properties._d_factor, _public_properties._radius_modifier};
+        std::vector<LandscapePoint> minima = _landscape.findMinima(candidates, optimized, fixed, _public_properties._opt_xerror_weight, _public_properties._opt_yerror_weight, _public_properties._opt_rerror_weight, _public_properties._opt_aerror_weight);
+        if (!minima.empty())
+        {
+            points.clear();
+            for (const LandscapePoint &minimum : minima)
+            {
+                std::vector<double> point;
+                for (int i = 0; i < 3; i++)
+                {
+                    if (optimized[i])
+                        point.push_back(minimum[i]);
+                }
+                points.push_back(point);
+            }
+            first_level = levels - 1;
+        }
     }
-    catch (const std::exception &e)
+
+    std::vector<double> errors;
+    for (int level = first_level; level < levels; level++)
     {
-        std::cerr << "Optimizer crashed with error: " << e.what() << '\n';
+        errors.assign(points.size(), HUGE_VAL);
+        ThreadPool::shared().parallelFor(0, int(points.size()), int(points.size()), [&](int p, int, int)
+                                         { errors[p] = local_search(points[p], level); });
+        if (progress.isCancelled())
+            break;
+
+        // keep the best candidates (stable, so ties keep the lower index)
+        std::vector<int> order(points.size());
+        for (int p = 0; p < int(points.size()); p++)
+            order[p] = p;
+        std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+                         { return errors[a] < errors[b]; });
+
+        int keep = level == levels - 1 ? 1 : std::min(candidates, int(points.size()));
+        std::vector<std::vector<double>> best_points;
+        std::vector<double> best_errors;
+        for (int k = 0; k < keep; k++)
+        {
+            best_points.push_back(points[order[k]]);
+            best_errors.push_back(errors[order[k]]);
+        }
+        points = best_points;
+        errors = best_errors;
     }
 
-    std::cout << "Optimization result: " << " Error: " << minf << std::endl;
+    std::vector<double> x = points[0];
+    double minf = errors[0];
+    if (progress.isCancelled())
+    {
+        if (progress.level < 0)
+            return; // nothing evaluated yet, keep the current parameters
+        x = progress.x;
+        minf = progress.error;
+        std::cout << "Optimization cancelled, best error per grid point: " << minf << std::endl;
+    }
+    else
+    {
+        std::cout << "Optimization result: " << " Error: " << minf << std::endl;
+    }
 
     if (_public_properties._optimize_interpolation_factor)
     {
@@ -576,6 +1352,76 @@ void Model::optimizeParameters()
     }
 }
 
+ErrorLandscapeKey Model::getLandscapeKey()
+{
+    return {_public_properties._crop_top, _public_properties._crop_bottom, _public_properties._crop_left, _public_properties._crop_right,
+            _public_properties._tilt, _public_properties._spline_smoothing, _public_properties._preview_image_scale,
+            _public_properties._enforce_isotropy, _public_properties._d_restrict, _public_properties._errors_analytic};
+}
+
+bool Model::landscapeRequired()
+{
+    return _public_properties._opt_landscape && !(_landscape.matches(getLandscapeKey()) && _landscape.isComplete());
+}
+
+// samples the error sums on the lattice of the landscape, every (IF, d) slab needs one table setup
+// and one reduction per radius node. the slabs are distributed over the shared thread pool,
+// a cancelled computation keeps the finished slabs
+void Model::computeLandscape(const std::atomic<bool> *cancelled)
+{
+    if (!_public_properties._opt_landscape)
+        return;
+
+    ErrorLandscapeKey key = getLandscapeKey();
+    if (!_landscape.matches(key))
+    {
+        // radius range of optimizeParameters on the side of the slope sign. the lattice is logarithmic,
+        // so with a negative slope it stops at -0.5 instead of crossing zero up to the optimizer's 0.5
+        _landscape.reset(key, _slope < 0 ? -500 : 0.5, _slope < 0 ? -0.5 : 500);
+    }
+    if (_landscape.isComplete())
+        return;
+
+    Timer timer("Landscape");
+    bool analytic = _public_properties._errors_analytic;
+    double grid_points = LANDSCAPE_DIMS * LANDSCAPE_DIMS;
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(0, LANDSCAPE_IF_NODES * LANDSCAPE_D_NODES, pool.size(), [&](int, int slab_begin, int slab_end)
+                     {
+        OptimizationState state(*_ifcurve, LANDSCAPE_DIMS, analytic);
+        state._error_mapper.setParallel(false);
+        state._error_mapper.setMode(analytic ? ERROR_MODE_ANALYTIC : ERROR_MODE_JITTER);
+        std::vector<ErrorSums> sums(LANDSCAPE_RAD_NODES);
+
+        for (int slab = slab_begin; slab < slab_end; slab++)
+        {
+            int if_node = slab / LANDSCAPE_D_NODES;
+            int d_node = slab % LANDSCAPE_D_NODES;
+            if (_landscape.isSlabFilled(if_node, d_node))
+                continue;
+            if (cancelled != nullptr && *cancelled)
+                return;
+
+            float interpolation_factor = _landscape.getIF(if_node);
+            float d_lower, d_upper;
+            getDBounds(interpolation_factor, d_lower, d_upper);
+            state._ifcurve.setInterpolationFactor(interpolation_factor);
+            state._ifcurve.setDBounds(d_lower, d_upper);
+            state._ifcurve.setDFactor(_landscape.getD(d_node));
+            if (analytic)
+                setupAnalyticErrorMappingTables(LANDSCAPE_DIMS, LANDSCAPE_DIMS, state._mapping_tables, state._ifcurve);
+            else
+                setupErrorMappingTables(LANDSCAPE_DIMS, LANDSCAPE_DIMS, state._mapping_tables, state._ifcurve);
+
+            for (int rad_node = 0; rad_node < LANDSCAPE_RAD_NODES; rad_node++)
+            {
+                ErrorSums s = state._error_mapper.reduce(LANDSCAPE_DIMS, LANDSCAPE_DIMS, &state._mapping_tables, _arc_length, interpolation_factor, _landscape.getRad(rad_node), _public_properties._tilt, _public_properties._crop_left, _public_properties._crop_right);
+                sums[rad_node] = {s.x / grid_points, s.y / grid_points, s.r / grid_points, s.a / grid_points};
+            }
+            _landscape.setSlab(if_node, d_node, sums);
+        } });
+}
+
 boost::json::object Model::getInterpolationPlotData()
 {
     boost::json::object plot_data;
@@ -584,9 +1430,8 @@ boost::json::object Model::getInterpolationPlotData()
     std::vector<float> x;
     linspace(x, _a_x_bounds._lower, _a_x_bounds._upper, 100);
 
-    std::vector<float> y_contour;
-    std::transform(x.begin(), x.end(), std::back_inserter(y_contour), [this](float value)
-                   { return alglib::spline1dcalc(_a_x_y_spline, value); });
+    std::vector<float> y_contour(x.size());
+    _a_x_y_cubic.evaluate(x.data(), int(x.size()), y_contour.data());
 
     std::vector<float> y_linear;
     std::transform(x.begin(), x.end(), std::back_inserter(y_linear), [this](float value)
@@ -595,7 +1440,7 @@ boost::json::object Model::getInterpolationPlotData()
     std::vector<float> y_interp;
     std::transform(x.begin(), x.end(), std::back_inserter(y_interp), [this](float value)
                    {
-    float r_orig = alglib::spline1dcalc(_a_x_y_spline, value);
+    float r_orig = _a_x_y_cubic(value);
     float r_linear = _slope * value + _intercept;
 
     return (r_linear + (r_orig - r_linear) * _public_properties._interpolation_factor); });
@@ -666,7 +1511,7 @@ Vec4 Model::getCirclePoint(double r, Vec4 cp, double arc_offset)
 
 double Model::getRadiusIF(float h_a, double cIF)
 {
-    float r_orig = alglib::spline1dcalc(_a_x_y_spline, h_a);
+    float r_orig = _a_x_y_cubic(h_a);
     float r_fit = _slope * h_a + _intercept;
 
     return (r_fit + (r_orig - r_fit) * cIF);
@@ -675,7 +1520,7 @@ double Model::getRadiusIF(float h_a, double cIF)
 Vec4 Model::mapPoint(double x, double y)
 {
     double h_z = y * _height;
-    double h_a = alglib::spline1dcalc(_x_a_x_spline, h_z);
+    double h_a = _x_a_x_cubic(h_z);
     double h_a_EF = _public_properties._enforce_isotropy ? getEFHeight(h_a) : h_a;
     double arc_offset = 0.0;
 
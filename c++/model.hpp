@@ -2,23 +2,34 @@
 #define MODEL_H
 
 #include <vector>
+#include <atomic>
 #include <functional>
 #include <boost/json.hpp>
 
 #include "util.hpp"
 #include "unsupported/Eigen/Splines"
 #include "alglib-cpp/src/interpolation.h"
+#include "cubic_spline.hpp"
 
 #include "shader.hpp"
 #include "gl_image_mapper.hpp"
-#include "gl_grid_mapper.hpp"
+#include "cpu_image_mapper.hpp"
+#include "cpu_grid_mapper.hpp"
 #include "cpu_error_mapper.hpp"
 #include "gl_renderer.hpp"
+#include "cpu_renderer.hpp"
 
 #include "ifcurve.hpp"
+#include "error_landscape.hpp"
+#include "stage_graph.hpp"
 
 #define INVALID_MODEL_PARAM -1
 
+// local optimizers of optimizeParameters, the gradient based ones use dual numbers (jittered errors only)
+#define OPT_ALGORITHM_BOBYQA 0
+#define OPT_ALGORITHM_LBFGS 1
+#define OPT_ALGORITHM_SLSQP 2
+
 class Bounds
 {
 public:
@@ -117,6 +128,12 @@ public:
     ModelPublicProperty<bool> _optimize_interpolation_factor = false;
     ModelPublicProperty<bool> _optimize_d_factor = false;
     ModelPublicProperty<bool> _optimize_radius_modifier = false;
+    ModelPublicProperty<int> _opt_coarse_dims = 16;  // error grid size of the global search
+    ModelPublicProperty<int> _opt_final_dims = 100;  // error grid size of the last refinement
+    ModelPublicProperty<int> _opt_levels = 3;        // number of grid sizes from coarse to final
+    ModelPublicProperty<int> _opt_candidates = 2;    // best starts refined on the finer grids
+    ModelPublicProperty<int> _opt_algorithm = OPT_ALGORITHM_BOBYQA; // local optimizer, see OPT_ALGORITHM_*
+    ModelPublicProperty<bool> _opt_landscape = false;                // precomputed error landscape as starting points
     ModelPublicProperty<float> _tilt = 0;
     ModelPublicProperty<float> _image_rotation = 0.f;
     ModelPublicProperty<float> _vertical_shift = 0.f;
@@ -135,12 +152,161 @@ public:
     ModelPublicProperty<bool> _generate_error_maps = false;
     ModelPublicProperty<float> _error_map_quality = 1.f;
     ModelPublicProperty<bool> _errors_use_gpu = false;
+    ModelPublicProperty<bool> _errors_vectorized = false; // float SIMD error kernel for the error maps (opt-in, the double kernel is the reference)
+    ModelPublicProperty<bool> _errors_analytic = false;   // errors from the closed form Jacobian instead of jittered points
     ModelPublicProperty<bool> _plot_interpolation = false;
     ModelPublicProperty<bool> _plot_ifcurve = false;
     ModelPublicProperty<float> _spline_smoothing = 0.000001f; // 1e-06 min value currently
     ModelPublicProperty<int> _render_max_res = 1000;
+    ModelPublicProperty<bool> _render_use_cpu = false; // software rasterizer instead of the GL renderer
+    ModelPublicProperty<bool> _map_use_cpu = false;    // CPU image mapper instead of the compute shader, with _render_use_cpu no GL context is needed (usesGPU)
+    ModelPublicProperty<bool> _render_warp = false;    // backward warp of the image instead of mapping and rasterizing a mesh
+    ModelPublicProperty<bool> _render_resident = false; // GL mapper output rendered in place, without reading the mesh back
+    ModelPublicProperty<bool> _render_textured = false; // coarse mesh with texture coordinates, the image is sampled per fragment
+    ModelPublicProperty<int> _texture_mesh_step = 8;    // image pixels per mesh cell (per direction) of the textured mesh
+    ModelPublicProperty<bool> _render_adaptive = false; // textured mesh refined where the mapping bends, instead of _texture_mesh_step
+    ModelPublicProperty<float> _adaptive_tolerance = 0.5f; // max. deviation of the adaptive mesh from the mapping in output pixels
+};
+
+// per-evaluation state of the optimizer and of parameter sweeps (everything an evaluation writes)
+// every concurrently running local search or sweep slab owns one, the Model itself is only read
+struct OptimizationState
+{
+    // dims: size of the error grid, the jittered tables are allocated twice as large
+    OptimizationState(const IFCurve &ifcurve, int dims, bool analytic)
+        : _dims(dims), _ifcurve(ifcurve), _mapping_tables(analytic ? dims : dims * 2, analytic ? dims : dims * 2, analytic) {}
+
+    int _dims;
+    IFCurve _ifcurve;
+    MappingTables _mapping_tables;
+    MappingTableGradients _gradients; // only used by gradient based optimizers
+    ErrorMapper _error_mapper;
+};
+
+// called with the best parameters found so far (same keys as the parameter feedback)
+typedef std::function<void(const boost::json::object &feedback)> OptimizationProgressCallback;
+
+// one point of a parameter sweep (see Model::sweepErrors)
+struct SweepPoint
+{
+    float interpolation_factor;
+    float d_value; // d-value of the IF curve, not the d-factor
+    float radius_modifier;
+};
+
+//********************************/
+// Pipeline stage keys
+
+// splines, linear fit and isotropy table
+struct ContourKey
+{
+    float spline_smoothing, crop_top, crop_bottom;
+
+    bool operator==(const ContourKey &other) const
+    {
+        return spline_smoothing == other.spline_smoothing && crop_top == other.crop_top && crop_bottom == other.crop_bottom;
+    }
+};
+
+// rows of the mapping tables
+struct RowTablesKey
+{
+    ContourKey contour;
+    int height;
+    bool alp, enforce_isotropy;
+    float if_0; // only used with enforce_isotropy
+
+    bool operator==(const RowTablesKey &other) const
+    {
+        return contour == other.contour && height == other.height && alp == other.alp && enforce_isotropy == other.enforce_isotropy && if_0 == other.if_0;
+    }
+};
+
+struct RowTables
+{
+    std::vector<float> x_a_x, a_x_y, linear_fit;
+};
+
+// IF curve integrals of the columns of the mapping tables
+struct ColumnTablesKey
+{
+    int width;
+    float crop_left, crop_right;
+    std::vector<float> if_params; // IFCurveFunction::getParams
+
+    bool operator==(const ColumnTablesKey &other) const
+    {
+        return width == other.width && crop_left == other.crop_left && crop_right == other.crop_right && if_params == other.if_params;
+    }
+};
+
+// mapping tables and the parameters a mapper gets with them
+struct MappingKey
+{
+    RowTablesKey rows;
+    ColumnTablesKey columns;
+    float interpolation_factor, radius_modifier, tilt;
+
+    bool operator==(const MappingKey &other) const
+    {
+        return rows == other.rows && columns == other.columns && interpolation_factor == other.interpolation_factor &&
+               radius_modifier == other.radius_modifier && tilt == other.tilt;
+    }
+};
+
+#define IMAGE_STAGE_MESH 0     // vertices and colours of the image mapper
+#define IMAGE_STAGE_TEXTURED 1 // vertices of the image mapper, the colours come from the texture
+#define IMAGE_STAGE_ADAPTIVE 2 // CPUImageMapper::tessellate
+
+// output of the image mapper or the adaptive mesh
+struct ImageMapKey
+{
+    MappingKey mapping;
+    int mode;
+    float image_rotation, vertical_shift; // not used by the textured mesh (texture coordinates are per frame)
+    bool map_use_cpu, resident;
+    int render_size;                      // adaptive mesh only
+    float tolerance;                      // adaptive mesh only
+
+    bool operator==(const ImageMapKey &other) const
+    {
+        return mapping == other.mapping && mode == other.mode && image_rotation == other.image_rotation && vertical_shift == other.vertical_shift &&
+               map_use_cpu == other.map_use_cpu && resident == other.resident && render_size == other.render_size && tolerance == other.tolerance;
+    }
+};
+
+struct GridMapKey
+{
+    MappingKey horizontal, vertical;
+
+    bool operator==(const GridMapKey &other) const
+    {
+        return horizontal == other.horizontal && vertical == other.vertical;
+    }
+};
+
+// error maps (their tables are built by setupErrorMappingTables / setupAnalyticErrorMappingTables)
+struct ErrorMapKey
+{
+    ContourKey contour;
+    std::vector<float> if_params;
+    float crop_left, crop_right;
+    bool enforce_isotropy;
+    float interpolation_factor, radius_modifier, tilt;
+    float quality;
+    bool use_gpu, vectorized, analytic;
+
+    bool operator==(const ErrorMapKey &other) const
+    {
+        return contour == other.contour && if_params == other.if_params && crop_left == other.crop_left && crop_right == other.crop_right &&
+               enforce_isotropy == other.enforce_isotropy && interpolation_factor == other.interpolation_factor && radius_modifier == other.radius_modifier &&
+               tilt == other.tilt && quality == other.quality && use_gpu == other.use_gpu && vectorized == other.vectorized && analytic == other.analytic;
+    }
 };
 
+// called with the error sums of the points first_point, first_point + 1, ...
+typedef std::function<void(int first_point, const std::vector<ErrorSums> &sums)> SweepOutputCallback;
+
 class Model
 {
 public:
@@ -153,25 +319,74 @@ public:
     void cropTop(float amount);
     void cropBottom(float amount);
     void linearFit();
+    void setupIsotropyTable();
+    void updateContour();
+    float getIsotropyIntegral(float h_a);
+    float getXDistortion(float h_a, float if_0);
     float getEFHeight(float h_a);
+    float getEFHeight(float h_a, float if_0);
+    float getEFHeightDerivative(float h_a);
 
     void setupMappingTables(int width, int height, MappingTables &mapping_tablesm, bool alp = false);
+    ContourKey getContourKey();
+    RowTablesKey getRowTablesKey(int height, bool alp);
+    ColumnTablesKey getColumnTablesKey(int width);
+    MappingKey getMappingKey(int width, int height, bool alp = false);
     void setupErrorMappingTables(int width, int height, MappingTables &mapping_tables);
+    void setupErrorMappingTables(int width, int height, MappingTables &mapping_tables, IFCurve &ifcurve);
+    void setupErrorMappingTableGradients(int width, int height, MappingTables &mapping_tables, IFCurve &ifcurve, const Dual &interpolation_factor, const Dual &d_value, MappingTableGradients &gradients);
+    void setupAnalyticErrorMappingTables(int width, int height, MappingTables &mapping_tables);
+    void setupAnalyticErrorMappingTables(int width, int height, MappingTables &mapping_tables, IFCurve &ifcurve);
 
     RenderResult renderImage();
     RenderResult renderError(int error_type);
     RenderResult renderGrid();
 
+    // the selected backends need a GL context (the GL objects are only created on first use)
+    bool usesGPU();
+
+    // backward warp of the full resolution image streamed into a PNG in bands of bounded memory,
+    // render_size is not limited by _render_max_res (the grid is not drawn)
+    bool exportImage(const std::string &path, int render_size);
+
+    // hits and misses of the pipeline stages, one line per stage
+    std::vector<const StageCounters *> getStages() const;
+    std::string getStageStatistics() const;
+
     void mapImage(int width, int height);
     void mapErrors();
     void mapGrid(int width, int height);
+    void sweepErrors(const std::vector<SweepPoint> &points, const SweepOutputCallback &output);
 
     void registerObservers();
     void updateState();
     bool checkPropertiesValid();
     void updateBetaBounds();
+    void getDBounds(float interpolation_factor, float &lower, float &upper, float *lower_slope = nullptr, float *upper_slope = nullptr);
 
-    void optimizeParameters();
+    // cancelled (optional): stops the optimization, the best parameters found so far are applied
+    // progress (optional): called from the optimizer threads, at most every OPTIMIZATION_PROGRESS_INTERVAL
+    void optimizeParameters(const std::atomic<bool> *cancelled = nullptr, const OptimizationProgressCallback &progress = nullptr);
+
+    // with deferred optimization updateState only marks the optimization as pending,
+    // the caller runs optimizeParameters itself (e.g. as a background job)
+    void setDeferOptimization(bool defer)
+    {
+        _defer_optimization = defer;
+    }
+
+    bool takePendingOptimization()
+    {
+        bool pending = _optimization_pending;
+        _optimization_pending = false;
+        return pending;
+    }
+
+    // error landscape of the current properties (only with _opt_landscape), computing it can be
+    // cancelled and continues where it stopped
+    ErrorLandscapeKey getLandscapeKey();
+    bool landscapeRequired();
+    void computeLandscape(const std::atomic<bool> *cancelled = nullptr);
 
     boost::json::object getInterpolationPlotData();
     boost::json::object getIFCurvePlotData();
@@ -192,11 +407,27 @@ public:
         return _ifcurve;
     }
 
+    float getArcLength()
+    {
+        return _arc_length;
+    }
+
     Vec4 getCirclePoint(double r, Vec4 cp, double arc_offset);
     double getRadiusIF(float h_a, double cIF);
     Vec4 mapPoint(double x, double y);
 
 private:
+    // GL or software renderer, depending on _render_use_cpu
+    RenderResult renderTriangles(int width, int height, RenderData render_data);
+    RenderResult renderLines(int num_points, int num_indices, RenderData render_data);
+    // the mapped image stays on the GPU (GL mapper and GL renderer)
+    bool renderResident();
+    // GL mapper (with the image texture uploaded) and GL renderer, created on first use
+    ImageMapper *getImageMapper();
+    Renderer *getRenderer();
+    // texture coordinates of the columns and rows of the width x height image mapping (as in image_map.comp)
+    void getImageTexCoords(int width, int height, std::vector<float> &u, std::vector<float> &v);
+
     // ************* static members
     std::vector<float> _x;   // samples of the z-height of the input mask
     std::vector<float> _a_x; // samples of the arc-length of the input mask (same z-height as _x)
@@ -207,14 +438,19 @@ private:
 
     alglib::spline1dinterpolant _a_x_y_spline; // mapping from arc-length to radius
     alglib::spline1dinterpolant _x_a_x_spline; // mapping from z-height to arc-length
+    CubicSpline _a_x_y_cubic;                  // polynomials of _a_x_y_spline, all evaluations use these
+    CubicSpline _x_a_x_cubic;                  // polynomials of _x_a_x_spline
 
-    unsigned char *_image;
+    unsigned char *_image = nullptr;
     int _image_width, _image_height;
 
     ImageMapper *_image_mapper = nullptr;
-    GridMapper *_grid_mapper = nullptr;
+    bool _image_texture_loaded = false; // _image is in the texture of _image_mapper
+    CPUImageMapper *_cpu_image_mapper = nullptr;
+    CPUGridMapper *_grid_mapper = nullptr;
     ErrorMapper *_error_mapper = nullptr;
     Renderer *_renderer = nullptr;
+    CPURenderer *_cpu_renderer = nullptr;
     IFCurve *_ifcurve = nullptr;
 
     // ************* dynamic members
@@ -224,10 +460,24 @@ private:
     float _slope;     // contour linear fit slope
     float _intercept; // contour linear fit intercept
 
+    // cumulative integral of r_linear / r_contour over [0, _arc_length] and its integrand at the
+    // nodes, every getEFHeight is an interpolation (rebuilt with the splines and the linear fit)
+    std::vector<float> _isotropy_integral;
+    std::vector<float> _isotropy_integrand;
+
     ModelPublicProperties _public_properties;
-    bool _remap_image = false;
-    bool _remap_grid = false;
-    bool _remap_errors = false;
+
+    // ************* pipeline stages
+    Stage<ContourKey> _contour_stage{"contour"};
+    StageCache<RowTablesKey, RowTables, 4> _row_tables{"row tables"}; // image, export and both grid directions
+    StageCache<ColumnTablesKey, std::vector<float>, 4> _column_tables{"column integrals"};
+    Stage<ImageMapKey> _image_stage{"image geometry"};
+    Stage<GridMapKey> _grid_stage{"grid geometry"};
+    Stage<ErrorMapKey> _error_stage{"error maps"};
+    bool _defer_optimization = false;
+    bool _optimization_pending = false;
+
+    ErrorLandscape _landscape;
 
     boost::json::object _parameter_feedback;
 };
@@ -0,0 +1,334 @@
+#include "png_writer.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "thread_pool.hpp"
+#include "util.hpp"
+
+//********************************/
+// Deflate
+
+// implemented by stb_image_write (declared by its implementation only)
+extern "C" unsigned char *stbi_zlib_compress(unsigned char *data, int data_len, int *out_len, int quality);
+extern "C" int stbi_write_png_compression_level;
+
+static const int LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int DISTANCE_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// bit position after the end of block code of a single fixed Huffman block, -1 if the data ends before it
+// (stb pads its last byte with zeros, the position is needed to append a block right after it)
+static long endOfFixedBlock(const unsigned char *data, size_t length)
+{
+    size_t bits = length * 8;
+    size_t bit = 3; // BFINAL, BTYPE
+    auto readBit = [&]()
+    {
+        uint32_t value = bit < bits ? (data[bit >> 3] >> (bit & 7)) & 1 : 0;
+        bit++;
+        return value;
+    };
+    auto readExtra = [&](int count) // least significant bit first
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < count; i++)
+            value |= readBit() << i;
+        return value;
+    };
+    auto readCode = [&](int count, uint32_t code) // most significant bit first
+    {
+        for (int i = 0; i < count; i++)
+            code = (code << 1) | readBit();
+        return code;
+    };
+
+    while (bit < bits)
+    {
+        uint32_t code = readCode(7, 0);
+        int symbol;
+        if (code <= 0x17)
+            symbol = 256 + code;
+        else
+        {
+            code = readCode(1, code);
+            if (code <= 0xbf)
+                symbol = code - 0x30;
+            else if (code <= 0xc7)
+                symbol = 280 + code - 0xc0;
+            else
+                symbol = 144 + readCode(1, code) - 0x190;
+        }
+
+        if (symbol == 256)
+            return bit <= bits ? long(bit) : -1;
+        if (symbol > 256)
+        {
+            readExtra(LENGTH_EXTRA[symbol - 257]);
+            readExtra(DISTANCE_EXTRA[readCode(5, 0)]);
+        }
+    }
+    return -1;
+}
+
+// deflates a piece with stbi_zlib_compress (without its zlib header and Adler-32). a piece that is
+// not the last one is made non-final and ends with an empty stored block, so the next piece starts
+// on a byte boundary
+static void deflatePiece(const unsigned char *data, int length, bool last, std::vector<unsigned char> &out)
+{
+    int zlib_length;
+    unsigned char *zlib = stbi_zlib_compress(const_cast<unsigned char *>(data), length, &zlib_length, stbi_write_png_compression_level);
+    out.assign(zlib + 2, zlib + zlib_length - 4);
+    free(zlib);
+    if (last)
+        return;
+
+    // stb writes one fixed Huffman block, or stored blocks if that is smaller
+    size_t end_bit;
+    if ((out[0] & 6) == 2)
+    {
+        out[0] &= ~1;
+        long end = endOfFixedBlock(out.data(), out.size());
+        assert(end >= 0);
+        end_bit = size_t(end);
+    }
+    else
+    {
+        size_t block = 0;
+        while (!(out[block] & 1))
+        {
+            block += 5 + (out[block + 1] | out[block + 2] << 8);
+        }
+        out[block] &= ~1;
+        end_bit = out.size() * 8;
+    }
+
+    // the 3 header bits of the stored block (zeros) fit into the padding of the last byte or start a new one
+    out.resize((end_bit + 7) / 8);
+    if (out.size() * 8 - end_bit < 3)
+        out.push_back(0x00);
+    const unsigned char empty[4] = {0x00, 0x00, 0xff, 0xff}; // LEN, NLEN
+    out.insert(out.end(), empty, empty + 4);
+}
+
+static uint32_t adler32(const unsigned char *data, size_t length, uint32_t adler)
+{
+    uint32_t a = adler & 0xffff, b = adler >> 16;
+    while (length > 0)
+    {
+        size_t block = std::min<size_t>(length, 5552); // no overflow before the modulo
+        for (size_t i = 0; i < block; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += block;
+        length -= block;
+    }
+    return (b << 16) | a;
+}
+
+//********************************/
+// PNG filters
+
+static inline int paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+// filtered byte i of a row, previous is nullptr for the first row of the image
+static inline unsigned char filterByte(int type, const unsigned char *row, const unsigned char *previous, int i)
+{
+    int a = i >= 4 ? row[i - 4] : 0;
+    int b = previous ? previous[i] : 0;
+    int c = previous && i >= 4 ? previous[i - 4] : 0;
+    switch (type)
+    {
+    case 1:
+        return (unsigned char)(row[i] - a);
+    case 2:
+        return (unsigned char)(row[i] - b);
+    case 3:
+        return (unsigned char)(row[i] - ((a + b) >> 1));
+    case 4:
+        return (unsigned char)(row[i] - paeth(a, b, c));
+    default:
+        return row[i];
+    }
+}
+
+// filter type byte and the filtered row: the type with the smallest sum of the absolute signed
+// differences (heuristic of the PNG specification)
+static void filterRow(const unsigned char *row, const unsigned char *previous, int bytes, unsigned char *out)
+{
+    int best_type = 0;
+    long best_sum = -1;
+    for (int type = 0; type < 5; type++)
+    {
+        long sum = 0;
+        for (int i = 0; i < bytes; i++)
+        {
+            sum += std::abs(int((signed char)filterByte(type, row, previous, i)));
+        }
+        if (best_sum < 0 || sum < best_sum)
+        {
+            best_sum = sum;
+            best_type = type;
+        }
+    }
+
+    out[0] = (unsigned char)best_type;
+    for (int i = 0; i < bytes; i++)
+    {
+        out[i + 1] = filterByte(best_type, row, previous, i);
+    }
+}
+
+static void writeBigEndian(unsigned char *out, uint32_t value)
+{
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+//********************************/
+// PNGStreamWriter implementation
+
+PNGStreamWriter::~PNGStreamWriter()
+{
+    close();
+}
+
+bool PNGStreamWriter::open(const std::string &path, int width, int height)
+{
+    close();
+    _file = fopen(path.c_str(), "wb");
+    if (_file == nullptr)
+    {
+        std::cerr << "Failed to create " << path << "\n";
+        return false;
+    }
+    _failed = false;
+    _width = width;
+    _height = height;
+    _rows = 0;
+    _adler = 1;
+
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (fwrite(signature, 1, 8, _file) != 8)
+        _failed = true;
+
+    unsigned char header[13];
+    writeBigEndian(header, uint32_t(width));
+    writeBigEndian(header + 4, uint32_t(height));
+    header[8] = 8;  // bit depth
+    header[9] = 6;  // RGBA
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filters
+    header[12] = 0; // no interlace
+    writeChunk("IHDR", header, sizeof(header));
+    return !_failed;
+}
+
+bool PNGStreamWriter::writeRows(const unsigned char *image, int rows)
+{
+    if (_file == nullptr || _failed)
+        return false;
+    rows = std::min(rows, _height - _rows);
+    if (rows <= 0)
+        return true;
+
+    size_t stride = size_t(_width) * 4;
+    _filtered.resize((stride + 1) * rows);
+    ThreadPool &pool = ThreadPool::shared();
+    pool.parallelFor(0, rows, pool.size(), [&](int, int begin, int end)
+                     {
+        for (int r = begin; r < end; r++)
+        {
+            const unsigned char *previous = r > 0 ? image + (r - 1) * stride : (_rows > 0 ? _previous.data() : nullptr);
+            filterRow(image + r * stride, previous, int(stride), &_filtered[r * (stride + 1)]);
+        } });
+    _previous.assign(image + (rows - 1) * stride, image + rows * stride);
+    _adler = adler32(_filtered.data(), _filtered.size(), _adler);
+
+    bool first = _rows == 0;
+    _rows += rows;
+    bool last = _rows == _height;
+
+    // the pieces are deflated in parallel, the last piece of the image ends the stream
+    size_t total = _filtered.size();
+    int pieces = int(std::clamp<size_t>(total / PNG_DEFLATE_PIECE, 1, size_t(pool.size()) * 2));
+    _pieces.resize(pieces);
+    pool.parallelFor(0, pieces, pieces, [&](int, int begin, int end)
+                     {
+        for (int p = begin; p < end; p++)
+        {
+            size_t piece_begin = total * p / pieces, piece_end = total * (p + 1) / pieces;
+            deflatePiece(&_filtered[piece_begin], int(piece_end - piece_begin), last && p == pieces - 1, _pieces[p]);
+        } });
+
+    _idat.clear();
+    if (first)
+    {
+        // zlib header: deflate with a 32K window, no dictionary
+        _idat.push_back(0x78);
+        _idat.push_back(0x01);
+    }
+    for (const std::vector<unsigned char> &piece : _pieces)
+    {
+        _idat.insert(_idat.end(), piece.begin(), piece.end());
+    }
+    if (last)
+    {
+        unsigned char adler[4];
+        writeBigEndian(adler, _adler);
+        _idat.insert(_idat.end(), adler, adler + 4);
+    }
+    writeChunk("IDAT", _idat.data(), _idat.size());
+    return !_failed;
+}
+
+bool PNGStreamWriter::close()
+{
+    if (_file == nullptr)
+        return false;
+    bool complete = _rows == _height;
+    if (complete)
+    {
+        writeChunk("IEND", nullptr, 0);
+    }
+    if (fclose(_file) != 0)
+        _failed = true;
+    _file = nullptr;
+    _previous.clear();
+    _previous.shrink_to_fit();
+    _filtered.clear();
+    _filtered.shrink_to_fit();
+    _pieces.clear();
+    _idat.clear();
+    _idat.shrink_to_fit();
+    return complete && !_failed;
+}
+
+void PNGStreamWriter::writeChunk(const char type[4], const unsigned char *data, size_t length)
+{
+    unsigned char header[8];
+    writeBigEndian(header, uint32_t(length));
+    std::memcpy(header + 4, type, 4);
+    unsigned char crc[4];
+    writeBigEndian(crc, crc32(data, length, crc32(header + 4, 4)));
+
+    if (fwrite(header, 1, 8, _file) != 8 || (length > 0 && fwrite(data, 1, length, _file) != length) || fwrite(crc, 1, 4, _file) != 4)
+    {
+        _failed = true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//********************************/
+// PNGStreamWriter implementation
+//
+// Writes an 8 bit RGBA PNG row by row, so an image never has to be in memory as a whole. Every
+// call of writeRows filters its rows, deflates them in independent pieces on the thread pool and
+// appends them as one IDAT chunk. A piece ends with an empty stored block (like a zlib sync flush),
+// so the pieces can be concatenated into one zlib stream without back references between them.
+// The pieces are deflated by stbi_zlib_compress.
+
+#define PNG_DEFLATE_PIECE 262144 // min. filtered bytes per deflate piece
+
+class PNGStreamWriter
+{
+public:
+    PNGStreamWriter() = default;
+    PNGStreamWriter(const PNGStreamWriter &) = delete;
+    PNGStreamWriter &operator=(const PNGStreamWriter &) = delete;
+
+    ~PNGStreamWriter();
+
+    // creates the file and writes the header, false on error
+    bool open(const std::string &path, int width, int height);
+
+    // appends rows (width x rows RGBA, top to bottom), false on error
+    bool writeRows(const unsigned char *image, int rows);
+
+    // ends the stream, false if not all rows were written or the file could not be written
+    bool close();
+
+private:
+    void writeChunk(const char type[4], const unsigned char *data, size_t length);
+
+    FILE *_file = nullptr;
+    bool _failed = false;
+    int _width = 0, _height = 0;
+    int _rows = 0;                          // rows written so far
+    uint32_t _adler = 1;                    // Adler-32 of the filtered rows
+    std::vector<unsigned char> _previous;   // last row of the previous call (for the filters)
+    std::vector<unsigned char> _filtered;   // filter type + filtered bytes per row
+    std::vector<std::vector<unsigned char>> _pieces;
+    std::vector<unsigned char> _idat;
+};
\ No newline at end of file
@@ -8,7 +8,14 @@
 #include <iostream>
 #include <string>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
 #include <fstream>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <vector>
 
 #include "cxxopts.hpp"
 
@@ -26,7 +33,179 @@ namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
 namespace net = boost::asio;            // from <boost/asio.hpp>
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
-void sendImageData(websocket::stream<tcp::socket> &ws, RenderResult result, std::string target)
+#define SESSION_SEND_QUEUE 8 // messages waiting to be written before write() blocks
+
+// websocket of a session. the session thread reads the commands, the session thread and its
+// optimization job write messages. a websocket stream is not thread-safe (a read also writes pongs
+// and the close frame), so every operation on it is started on the session's own io_context and
+// runs on its I/O thread, where reads and writes are serialized.
+// write() only queues the message, the completion of each async_write starts the next one, so the
+// next command is read and rendered while the previous images are still on the wire
+struct SessionSocket
+{
+    SessionSocket(tcp::socket socket) : work(net::make_work_guard(ioc)), ws(ioc)
+    {
+        // the accepted socket belongs to the io_context of the acceptor
+        tcp protocol = socket.local_endpoint().protocol();
+        ws.next_layer().assign(protocol, socket.release());
+        ws.read_message_max(0);
+        ws.binary(true);
+        io_thread = std::thread([this]()
+                                { ioc.run(); });
+    }
+
+    // sends the messages still queued
+    ~SessionSocket()
+    {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_changed.wait(lock, [this]()
+                               { return queue.empty() || failed; });
+        }
+
+        // the queue is flushed and the session thread no longer reads
+        net::post(ioc, [this]()
+                  {
+            beast::error_code ec;
+            ws.next_layer().close(ec); });
+        work.reset();
+        io_thread.join();
+    }
+
+    // starts op(handler) on the I/O thread and waits for the handler, throws its error
+    template <typename Op>
+    void await(Op op)
+    {
+        std::promise<beast::error_code> done;
+        net::post(ioc, [&]()
+                  { op([&](beast::error_code ec, auto...)
+                       { done.set_value(ec); }); });
+        beast::error_code ec = done.get_future().get();
+        if (ec)
+            throw beast::system_error(ec);
+    }
+
+    void accept()
+    {
+        await([this](auto handler)
+              { ws.async_accept(handler); });
+    }
+
+    // next message of the client (only called by the session thread)
+    void read(beast::flat_buffer &buffer)
+    {
+        await([this, &buffer](auto handler)
+              { ws.async_read(buffer, handler); });
+    }
+
+    // queues a copy of the message
+    void write(const unsigned char *data, size_t size)
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        queue_changed.wait(lock, [this]()
+                           { return queue.size() < SESSION_SEND_QUEUE || failed; });
+        if (failed)
+            return; // the session is closing, the read loop sees the error
+        queue.emplace_back(data, data + size);
+        if (queue.size() == 1) // no write in flight
+        {
+            net::post(ioc, [this]()
+                      { writeFront(); });
+        }
+    }
+
+    // runs on the I/O thread, the front message stays queued until it is written
+    // (push_back does not move the elements of a deque)
+    void writeFront()
+    {
+        std::vector<unsigned char> *message;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            message = &queue.front();
+        }
+        ws.async_write(net::buffer(*message), [this](beast::error_code ec, size_t)
+                       {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if (ec)
+            {
+                std::cerr << "Send error: " << ec.message() << std::endl;
+                failed = true;
+                queue.clear();
+            }
+            else
+            {
+                queue.pop_front();
+            }
+            bool more = !queue.empty();
+            lock.unlock();
+            queue_changed.notify_all();
+            if (more)
+                writeFront(); });
+    }
+
+    net::io_context ioc;
+    net::executor_work_guard<net::io_context::executor_type> work;
+    websocket::stream<tcp::socket> ws;
+    std::thread io_thread;
+    std::mutex queue_mutex;
+    std::condition_variable queue_changed;
+    std::deque<std::vector<unsigned char>> queue;
+    bool failed = false;
+};
+
+// background optimization of a session (Model::optimizeParameters)
+// the job owns the model and the GL context while it runs, the session thread cancels it
+// before handling the next command
+class OptimizationJob
+{
+public:
+    OptimizationJob(GLFWwindow *window) : _window(window) {}
+
+    ~OptimizationJob()
+    {
+        cancel();
+    }
+
+    // fn returns false if the optimization was cancelled before it finished
+    void start(std::function<bool(const std::atomic<bool> &cancelled)> fn)
+    {
+        _cancelled = false;
+        _completed = false;
+        glfwMakeContextCurrent(nullptr);
+        _thread = std::thread([this, fn]()
+                              {
+            glfwMakeContextCurrent(_window);
+            try
+            {
+                _completed = fn(_cancelled);
+            }
+            catch (std::exception const &e)
+            {
+                std::cerr << "Optimization error: " << e.what() << std::endl;
+            }
+            glfwMakeContextCurrent(nullptr); });
+    }
+
+    // stops a running job (the model keeps the best parameters found so far) and takes back the GL context
+    // returns true if the job was interrupted before it finished
+    bool cancel()
+    {
+        if (!_thread.joinable())
+            return false;
+        _cancelled = true;
+        _thread.join();
+        glfwMakeContextCurrent(_window);
+        return !_completed;
+    }
+
+private:
+    GLFWwindow *_window;
+    std::thread _thread;
+    std::atomic<bool> _cancelled{false};
+    std::atomic<bool> _completed{false};
+};
+
+void sendImageData(SessionSocket &socket, RenderResult result, std::string target)
 {
     boost::json::object meta;
     meta["command"] = "image";
@@ -52,13 +231,12 @@ void sendImageData(websocket::stream<tcp::socket> &ws, RenderResult result, std:
     std::memcpy(data + 4 + json_len, result.image, image_len);
 
     // Send as one binary message
-    ws.binary(true);
-    ws.write(boost::asio::buffer(data, size));
+    socket.write(data, size);
 
     delete[] data;
 }
 
-void sendModelLoaded(websocket::stream<tcp::socket> &ws)
+void sendModelLoaded(SessionSocket &socket)
 {
     boost::json::object meta;
     meta["command"] = "modelLoaded";
@@ -75,13 +253,12 @@ void sendModelLoaded(websocket::stream<tcp::socket> &ws)
     // Copy JSON
     std::memcpy(data + 4, meta_str.data(), json_len);
 
-    ws.binary(true);
-    ws.write(boost::asio::buffer(data, size));
+    socket.write(data, size);
 
     delete[] data;
 }
 
-void sendParameterFeedback(websocket::stream<tcp::socket> &ws, boost::json::object feedback)
+void sendParameterFeedback(SessionSocket &socket, boost::json::object feedback)
 {
     if (feedback.empty())
     {
@@ -103,13 +280,12 @@ void sendParameterFeedback(websocket::stream<tcp::socket> &ws, boost::json::obje
     // Copy JSON
     std::memcpy(data + 4, meta_str.data(), json_len);
 
-    ws.binary(true);
-    ws.write(boost::asio::buffer(data, size));
+    socket.write(data, size);
 
     delete[] data;
 }
 
-void sendPlotData(websocket::stream<tcp::socket> &ws, boost::json::object plot_data)
+void sendPlotData(SessionSocket &socket, boost::json::object plot_data)
 {
     boost::json::object meta;
     meta["command"] = "plot";
@@ -127,13 +303,12 @@ void sendPlotData(websocket::stream<tcp::socket> &ws, boost::json::object plot_d
     // Copy JSON
     std::memcpy(data + 4, meta_str.data(), json_len);
 
-    ws.binary(true);
-    ws.write(boost::asio::buffer(data, size));
+    socket.write(data, size);
 
     delete[] data;
 }
 
-void sendFinished(websocket::stream<tcp::socket> &ws)
+void sendFinished(SessionSocket &socket)
 {
     boost::json::object meta;
     meta["command"] = "finished";
@@ -150,13 +325,12 @@ void sendFinished(websocket::stream<tcp::socket> &ws)
     // Copy JSON
     std::memcpy(data + 4, meta_str.data(), json_len);
 
-    ws.binary(true);
-    ws.write(boost::asio::buffer(data, size));
+    socket.write(data, size);
 
     delete[] data;
 }
 
-void sendError(websocket::stream<tcp::socket> &ws, std::string error)
+void sendError(SessionSocket &socket, std::string error)
 {
     boost::json::object meta;
     meta["command"] = "error";
@@ -174,32 +348,123 @@ void sendError(websocket::stream<tcp::socket> &ws, std::string error)
     // Copy JSON
     std::memcpy(data + 4, meta_str.data(), json_len);
 
-    ws.binary(true);
-    ws.write(boost::asio::buffer(data, size));
+    socket.write(data, size);
 
     delete[] data;
 }
 
+// hits and misses of the pipeline stages of the session model (debug command)
+void sendStageStatistics(SessionSocket &socket, Model *model)
+{
+    boost::json::object stages;
+    for (const StageCounters *stage : model->getStages())
+    {
+        boost::json::object counters;
+        counters["hits"] = stage->getHits();
+        counters["misses"] = stage->getMisses();
+        stages[stage->getName()] = counters;
+    }
+    boost::json::object meta;
+    meta["command"] = "stageStatistics";
+    meta["stages"] = stages;
+
+    std::string meta_str = boost::json::serialize(meta);
+    uint32_t json_len = meta_str.size();
+
+    size_t size = 4 + json_len;
+    unsigned char *data = new unsigned char[size];
+
+    // Copy 4-byte JSON length
+    std::memcpy(data, &json_len, 4);
+
+    // Copy JSON
+    std::memcpy(data + 4, meta_str.data(), json_len);
+
+    socket.write(data, size);
+
+    delete[] data;
+}
+
+// render the current state and send the images, plots and parameter feedback of a tune
+void sendResults(SessionSocket &socket, Model *model)
+{
+    RenderResult result;
+
+    if (model->getModelPublicProperties()._image_active)
+    {
+        Timer *t = new Timer("Image");
+        result = model->renderImage();
+        delete t;
+    }
+
+    if (model->getModelPublicProperties()._grid_active)
+    {
+        Timer *t = new Timer("Grid");
+        result = model->renderGrid();
+        delete t;
+    }
+
+    if (model->getModelPublicProperties()._image_active || model->getModelPublicProperties()._grid_active)
+    {
+        sendImageData(socket, result, "preview");
+    }
+    else
+    {
+        result.image = new unsigned char[4 * 4 * 4];
+        memset(result.image, 0, 4 * 4 * 4);
+        result.width = 4;
+        result.height = 4;
+        sendImageData(socket, result, "preview");
+        delete[] result.image;
+    }
+
+    if (model->getModelPublicProperties()._generate_error_maps)
+    {
+        Timer *t = new Timer("Errors");
+        model->mapErrors();
+        sendImageData(socket, model->renderError(0), "xerror");
+        sendImageData(socket, model->renderError(1), "yerror");
+        sendImageData(socket, model->renderError(2), "xyerror");
+        sendImageData(socket, model->renderError(3), "rerror");
+        sendImageData(socket, model->renderError(4), "aerror");
+        delete t;
+    }
+
+    if (model->getModelPublicProperties()._plot_interpolation)
+    {
+        sendPlotData(socket, model->getInterpolationPlotData());
+    }
+    if (model->getModelPublicProperties()._plot_ifcurve)
+    {
+        sendPlotData(socket, model->getIFCurvePlotData());
+    }
+
+    sendParameterFeedback(socket, model->getParameterFeedback());
+}
+
 void doSession(tcp::socket socket)
 {
     std::cout << "Starting session for address: " << socket.remote_endpoint().address().to_string() << " on port: " << socket.local_endpoint().port() << "\n";
 
+    // without a context the session is limited to the CPU mapper and renderer
     GLFWwindow *w = initGLFWContext();
 
     Model *model = nullptr;
 
-    websocket::stream<tcp::socket> ws{std::move(socket)};
-    ws.read_message_max(0);
+    SessionSocket session{std::move(socket)};
+
+    OptimizationJob optimization(w);
+
 
     try
     {
-        ws.accept();
+        session.accept();
 
         beast::flat_buffer buffer;
 
         while (true)
         {
-            ws.read(buffer);
+            session.read(buffer);
             Timer *pt = new Timer("Packet");
             std::string message = beast::buffers_to_string(buffer.data());
             buffer.consume(buffer.size());
@@ -207,6 +472,28 @@ void doSession(tcp::socket socket)
             boost::json::value json_value = boost::json::parse(message);
             boost::json::object json_object = json_value.as_object();
 
+            // every command works on the model, a running optimization is stopped first
+            // (a cancelled optimization keeps the best parameters it has found so far)
+            bool optimization_interrupted = optimization.cancel();
+
+            if (json_object["command"].as_string() == "cancelOptimization")
+            {
+                if (optimization_interrupted && model != nullptr)
+                {
+                    sendResults(session, model);
+                }
+                sendFinished(session);
+            }
+
+            if (json_object["command"].as_string() == "stageStatistics")
+            {
+                if (model != nullptr)
+                {
+                    sendStageStatistics(session, model);
+                }
+                sendFinished(session);
+            }
+
             if (json_object["command"].as_string() == "loadProject")
             {
                 std::cout << "Loading a new project\n";
@@ -234,6 +521,12 @@ void doSession(tcp::socket socket)
                 loadMaskRaw(img_mask_raw, size_mask, x, a_x, y);
 
                 model = new Model(x, a_x, y);
+                model->setDeferOptimization(true); // runs as OptimizationJob
+                if (w == nullptr)
+                {
+                    model->getModelPublicProperties()._render_use_cpu.setValue({true, true});
+                    model->getModelPublicProperties()._map_use_cpu.setValue({true, true});
+                }
 
                 int width, height, channels;
                 unsigned char *img = stbi_load_from_memory(img_unrolling_raw, size_unrolling, &width, &height, &channels, CHANNELS);
@@ -241,19 +534,19 @@ void doSession(tcp::socket socket)
                 model->setImage(img, width, height);
 
                 std::cout << "Loaded a new project\n";
-                sendModelLoaded(ws);
+                sendModelLoaded(session);
 
                 delete[] img_mask_raw;
                 delete[] img_unrolling_raw;
 
-                sendFinished(ws);
+                sendFinished(session);
             }
             if (json_object["command"].as_string() == "tune")
             {
                 std::cout << message << "\n";
                 if (model == nullptr)
                 {
-                    sendFinished(ws);
+                    sendFinished(session);
                     continue;
                 }
 
@@ -270,6 +563,12 @@ void doSession(tcp::socket socket)
                 model->getModelPublicProperties()._optimize_interpolation_factor.setValue(getJsonBool(json_object["opt_if"]));
                 model->getModelPublicProperties()._optimize_d_factor.setValue(getJsonBool(json_object["opt_d"]));
                 model->getModelPublicProperties()._optimize_radius_modifier.setValue(getJsonBool(json_object["opt_rad"]));
+                model->getModelPublicProperties()._opt_coarse_dims.setValue(getJsonInt(json_object["opt_coarse_dims"]));
+                model->getModelPublicProperties()._opt_final_dims.setValue(getJsonInt(json_object["opt_final_dims"]));
+                model->getModelPublicProperties()._opt_levels.setValue(getJsonInt(json_object["opt_levels"]));
+                model->getModelPublicProperties()._opt_candidates.setValue(getJsonInt(json_object["opt_candidates"]));
+                model->getModelPublicProperties()._opt_algorithm.setValue(getJsonInt(json_object["opt_algorithm"]));
+                model->getModelPublicProperties()._opt_landscape.setValue(getJsonBool(json_object["opt_landscape"]));
                 model->getModelPublicProperties()._tilt.setValue(getJsonFloat(json_object["tilt"]));
                 model->getModelPublicProperties()._preview_image_scale.setValue(getJsonFloat(json_object["pif"]));
                 model->getModelPublicProperties()._image_rotation.setValue(getJsonFloat(json_object["ir"]));
@@ -287,73 +586,58 @@ void doSession(tcp::socket socket)
                 model->getModelPublicProperties()._enforce_isotropy.setValue(getJsonBool(json_object["enforce_isotropy"]));
                 model->getModelPublicProperties()._generate_error_maps.setValue(getJsonBool(json_object["errors_active"]));
                 model->getModelPublicProperties()._error_map_quality.setValue(getJsonFloat(json_object["errors_quality"]));
+                model->getModelPublicProperties()._errors_vectorized.setValue(getJsonBool(json_object["errors_simd"]));
+                model->getModelPublicProperties()._errors_analytic.setValue(getJsonBool(json_object["errors_analytic"]));
                 model->getModelPublicProperties()._plot_interpolation.setValue(getJsonBool(json_object["plot_interp"]));
                 model->getModelPublicProperties()._plot_ifcurve.setValue(getJsonBool(json_object["plot_ifcurve"]));
                 model->getModelPublicProperties()._spline_smoothing.setValue(getJsonFloat(json_object["spline_smoothing"]));
                 model->getModelPublicProperties()._render_max_res.setValue(getJsonInt(json_object["render_max_res"]));
+                model->getModelPublicProperties()._render_use_cpu.setValue(getJsonBool(json_object["render_cpu"]));
+                model->getModelPublicProperties()._map_use_cpu.setValue(getJsonBool(json_object["map_cpu"]));
+                if (w == nullptr)
+                {
+                    model->getModelPublicProperties()._render_use_cpu.setValue({true, true});
+                    model->getModelPublicProperties()._map_use_cpu.setValue({true, true});
+                }
+                model->getModelPublicProperties()._render_warp.setValue(getJsonBool(json_object["render_warp"]));
+                model->getModelPublicProperties()._render_resident.setValue(getJsonBool(json_object["render_resident"]));
+                model->getModelPublicProperties()._render_textured.setValue(getJsonBool(json_object["render_textured"]));
+                model->getModelPublicProperties()._texture_mesh_step.setValue(getJsonInt(json_object["texture_mesh_step"]));
+                model->getModelPublicProperties()._render_adaptive.setValue(getJsonBool(json_object["render_adaptive"]));
+                model->getModelPublicProperties()._adaptive_tolerance.setValue(getJsonFloat(json_object["adaptive_tolerance"]));
                 // gpu error mapping currently not supported
                 // model->getModelPublicProperties()._errors_use_gpu.setValue(get_json_bool(json_object["errors_use_gpu"]));
 
                 if (!model->checkPropertiesValid())
                 {
-                    sendFinished(ws);
+                    sendFinished(session);
                     continue;
                 }
                 model->updateState();
 
-                RenderResult result;
-
-                if (model->getModelPublicProperties()._image_active)
+                bool optimize = model->takePendingOptimization();
+                if (!optimize)
                 {
-                    Timer *t = new Timer("Image");
-                    result = model->renderImage();
-                    delete t;
+                    sendResults(session, model);
                 }
-
-                if (model->getModelPublicProperties()._grid_active)
-                {
-                    Timer *t = new Timer("Grid");
-                    result = model->renderGrid();
-                    delete t;
-                }
-
-                if (model->getModelPublicProperties()._image_active || model->getModelPublicProperties()._grid_active)
-                {
-                    sendImageData(ws, result, "preview");
-                }
-                else
-                {
-                    result.image = new unsigned char[4 * 4 * 4];
-                    memset(result.image, 0, 4 * 4 * 4);
-                    result.width = 4;
-                    result.height = 4;
-                    sendImageData(ws, result, "preview");
-                    delete[] result.image;
-                }
-
-                if (model->getModelPublicProperties()._generate_error_maps)
-                {
-                    Timer *t = new Timer("Errors");
-                    model->mapErrors();
-                    sendImageData(ws, model->renderError(0), "xerror");
-                    sendImageData(ws, model->renderError(1), "yerror");
-                    sendImageData(ws, model->renderError(2), "xyerror");
-                    sendImageData(ws, model->renderError(3), "rerror");
-                    sendImageData(ws, model->renderError(4), "aerror");
-                    delete t;
-                }
-
-                if (model->getModelPublicProperties()._plot_interpolation)
+                if (optimize || model->landscapeRequired())
                 {
-                    sendPlotData(ws, model->getInterpolationPlotData());
-                }
-                if (model->getModelPublicProperties()._plot_ifcurve)
-                {
-                    sendPlotData(ws, model->getIFCurvePlotData());
+                    // the results of an optimization are sent once it is done, the next command cancels the job
+                    optimization.start([&session, model, optimize](const std::atomic<bool> &cancelled)
+                                       {
+                        if (optimize)
+                        {
+                            model->optimizeParameters(&cancelled, [&session](const boost::json::object &feedback)
+                                                      { sendParameterFeedback(session, feedback); });
+                            if (cancelled)
+                                return false;
+                            sendResults(session, model);
+                        }
+                        // the error landscape for the next optimizations is computed while the session is idle
+                        model->computeLandscape(&cancelled);
+                        return true; });
                 }
-
-                sendParameterFeedback(ws, model->getParameterFeedback());
-                sendFinished(ws);
+                sendFinished(session);
             }
             delete pt;
         }
@@ -364,9 +648,10 @@ void doSession(tcp::socket socket)
     }
     catch (std::exception const &e)
     {
-        sendError(ws, std::string(e.what()));
+        sendError(session, std::string(e.what()));
         std::cerr << "Session error: " << e.what() << std::endl;
     }
+    optimization.cancel();
     delete model;
     destroyGLFWWindow(w);
 }
@@ -393,7 +678,7 @@ int main(int argc, char *argv[])
 
     if (!glfwInit())
     {
-        assert(false && "Failed to initialized GLFW Library");
+        std::cerr << "Failed to initialize GLFW, only the CPU backends are available\n";
     }
 
     try
@@ -6,14 +6,18 @@ GLFWwindow *initGLFWContext()
     GLFWwindow *window = glfwCreateWindow(1, 1, "", nullptr, nullptr);
     if (!window)
     {
-        assert(false && "Error initializing context.");
+        std::cerr << "Error initializing context.\n";
+        return nullptr;
     }
 
     glfwMakeContextCurrent(window);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
     {
-        assert(false && "Error loading function pointers.");
+        std::cerr << "Error loading function pointers.\n";
+        glfwMakeContextCurrent(nullptr);
+        glfwDestroyWindow(window);
+        return nullptr;
     }
 
     return window;
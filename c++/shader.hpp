@@ -8,6 +8,7 @@
 #include <vector>
 #include <cstring>
 
+// hidden window with a current GL context, nullptr if none could be created
 GLFWwindow *initGLFWContext();
 void destroyGLFWWindow(GLFWwindow *w);
 void cleanupGPU();
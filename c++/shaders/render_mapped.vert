@@ -0,0 +1,20 @@
+#version 450
+// vertices straight from the output buffers of the image mapper, normalized with the bounds of bounds.comp
+layout(location = 0) in float aX;
+layout(location = 1) in float aY;
+layout(location = 2) in vec3 aColor;
+layout(std430, binding = 8) readonly buffer Bounds {
+    uint bounds[];
+};
+out vec3 vColor;
+float decode(uint u) {
+    return uintBitsToFloat((u & 0x80000000u) != 0u ? u & 0x7fffffffu : ~u);
+}
+void main() {
+    vec2 b_min = vec2(decode(bounds[0]), decode(bounds[2]));
+    vec2 b_max = vec2(decode(bounds[1]), decode(bounds[3]));
+    vec2 clip = (vec2(aX, aY) - b_min) / ((b_max - b_min) / 2.0) - 1.0;
+    gl_Position = vec4(clip.x, -clip.y, 0.0, 1.0);
+    gl_PointSize = 1.0;
+    vColor = aColor;
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 450
+in vec2 vTexCoord;
+uniform sampler2D input_image;
+out vec4 FragColor;
+void main() {
+    // same rule as image_map.comp
+    vec4 pixel = texture(input_image, vTexCoord);
+    if (pixel.a < 1.0) {
+        pixel = vec4(1.0, 1.0, 1.0, 1.0);
+    }
+    FragColor = vec4(pixel.rgb, 1.0);
+}
\ No newline at end of file
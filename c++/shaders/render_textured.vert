@@ -0,0 +1,14 @@
+#version 450
+// texture coordinates from the grid index of the vertex (GridTexCoords)
+in vec2 aPos;
+uniform uint width;
+layout(std430, binding = 9) readonly buffer TexCoords {
+    float tex_coords[]; // u per column, then v per row
+};
+out vec2 vTexCoord;
+void main() {
+    uint xi = uint(gl_VertexID) % width;
+    uint yi = uint(gl_VertexID) / width;
+    gl_Position = vec4(aPos, 0.0, 1.0);
+    vTexCoord = vec2(tex_coords[xi], tex_coords[width + yi]);
+}
\ No newline at end of file
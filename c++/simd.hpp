@@ -0,0 +1,167 @@
+#pragma once
+
+//********************************/
+// 8-lane float vectors (SoA kernels)
+//
+// Built on GCC/Clang vector extensions: with -mavx2 a vfloat8 is a single ymm register,
+// otherwise the compiler splits it into two SSE registers.
+// All helpers are static so translation units compiled with different instruction sets
+// never share a definition.
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ANROLL_HAS_VECTOR_EXTENSIONS 1
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define SIMD_LANES 8
+
+typedef float vfloat8 __attribute__((vector_size(32)));
+typedef int vint8 __attribute__((vector_size(32)));
+
+static inline vfloat8 vset(float v)
+{
+    return vfloat8{v, v, v, v, v, v, v, v};
+}
+
+static inline vfloat8 vload(const float *p)
+{
+    vfloat8 v;
+    __builtin_memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void vstore(float *p, vfloat8 v)
+{
+    __builtin_memcpy(p, &v, sizeof(v));
+}
+
+// lane-wise m ? a : b, m is a comparison result (all bits set or zero)
+static inline vfloat8 vselect(vint8 m, vfloat8 a, vfloat8 b)
+{
+    return (vfloat8)((m & (vint8)a) | (~m & (vint8)b));
+}
+
+static inline vfloat8 vabs(vfloat8 x)
+{
+    return (vfloat8)((vint8)x & 0x7fffffff);
+}
+
+static inline vfloat8 vmin(vfloat8 a, vfloat8 b)
+{
+    return vselect(a < b, a, b);
+}
+
+static inline vfloat8 vmax(vfloat8 a, vfloat8 b)
+{
+    return vselect(a > b, a, b);
+}
+
+static inline vfloat8 vclamp(vfloat8 x, float lo, float hi)
+{
+    return vmin(vmax(x, vset(lo)), vset(hi));
+}
+
+static inline vfloat8 vsqrt(vfloat8 x)
+{
+#if defined(__AVX__)
+    return (vfloat8)_mm256_sqrt_ps((__m256)x);
+#elif defined(__SSE__)
+    __m128 halves[2];
+    __builtin_memcpy(halves, &x, sizeof(x));
+    halves[0] = _mm_sqrt_ps(halves[0]);
+    halves[1] = _mm_sqrt_ps(halves[1]);
+    __builtin_memcpy(&x, halves, sizeof(x));
+    return x;
+#else
+    for (int l = 0; l < SIMD_LANES; l++)
+    {
+        x[l] = __builtin_sqrtf(x[l]);
+    }
+    return x;
+#endif
+}
+
+// sin and cos, Cody-Waite reduction to [-pi/4, pi/4] with the cephes minimax polynomials.
+// absolute error <= 1.2e-7 for |x| <= 8192 (beyond that the reduction loses precision)
+static inline void vsincos(vfloat8 x, vfloat8 &s, vfloat8 &c)
+{
+    const float DP1 = 0.78515625f;
+    const float DP2 = 2.4187564849853515625e-4f;
+    const float DP3 = 3.77489497744594108e-8f;
+    const float FOPI = 1.27323954473516f; // 4 / pi
+
+    vint8 sign_sin = (vint8)x & (int)0x80000000;
+    x = vabs(x);
+
+    vint8 j = __builtin_convertvector(x * FOPI, vint8);
+    j = (j + 1) & ~1;
+    vfloat8 y = __builtin_convertvector(j, vfloat8);
+
+    // j is one of 0, 2, 4, 6: swap the polynomials for 2 and 6, flip sin for 4 and 6 and cos for 2 and 4
+    vint8 poly_swap = (j & 2) != 0;
+    sign_sin ^= ((j & 4) != 0) & (int)0x80000000;
+    vint8 sign_cos = (((j + 2) & 4) != 0) & (int)0x80000000;
+
+    x = ((x - y * DP1) - y * DP2) - y * DP3;
+    vfloat8 z = x * x;
+
+    vfloat8 pc = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+    vfloat8 ps = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+
+    s = vselect(poly_swap, pc, ps);
+    c = vselect(poly_swap, ps, pc);
+    s = (vfloat8)((vint8)s ^ sign_sin);
+    c = (vfloat8)((vint8)c ^ sign_cos);
+}
+
+// acos on [-1, 1], Abramowitz & Stegun 4.4.46: acos(x) = sqrt(1 - x) * P7(x) for x >= 0,
+// polynomial error <= 2e-8 rad, <= 5e-7 rad including float rounding. inputs are clamped to [-1, 1]
+static inline vfloat8 vacos(vfloat8 x)
+{
+    x = vclamp(x, -1.f, 1.f);
+    vint8 negative = x < 0.f;
+    vfloat8 ax = vabs(x);
+
+    vfloat8 p = vset(-0.0012624911f);
+    p = p * ax + 0.0066700901f;
+    p = p * ax - 0.0170881256f;
+    p = p * ax + 0.0308918810f;
+    p = p * ax - 0.0501743046f;
+    p = p * ax + 0.0889789874f;
+    p = p * ax - 0.2145988016f;
+    p = p * ax + 1.5707963050f;
+
+    vfloat8 r = vsqrt(1.0f - ax) * p;
+    return vselect(negative, vset(3.14159265358979f) - r, r);
+}
+
+// |x| < 2^31
+static inline vfloat8 vfloor(vfloat8 x)
+{
+    vfloat8 t = __builtin_convertvector(__builtin_convertvector(x, vint8), vfloat8);
+    return vselect(t > x, t - 1.f, t);
+}
+
+// semicircle mapping of the map shaders (see ErrorMapper::mapPoint)
+
+// arc offset of a point on the semicircle
+static inline vfloat8 arcOffset(vfloat8 x, vfloat8 area, float r_orig, float r_fit)
+{
+    vfloat8 ax = vabs(x);
+    vfloat8 c_if = vselect(ax > 0.f, area / ax, vset(0.f));
+    vfloat8 offset = 3.14159265358979f * x * (r_fit + (r_orig - r_fit) * c_if);
+    return vselect(ax > 0.f, offset, vset(0.f));
+}
+
+static inline void circlePoint(float r, float cp, float tilt, vfloat8 arc_offset, vfloat8 &x, vfloat8 &y)
+{
+    vfloat8 s, c;
+    vsincos(arc_offset / r, s, c);
+    x = r * s;
+    y = cp - r * c;
+    y = y * (1.f - tilt) + (cp - r) * tilt;
+}
+
+#endif
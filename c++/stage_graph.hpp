@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//********************************/
+// Stage graph
+//
+// Memoization of the Model pipeline. Every stage is keyed by a struct of all of its inputs
+// (with operator==, like ErrorLandscapeKey) and only recomputes when the key differs from the
+// one its output was computed for. A stage that depends on an earlier stage embeds that stage's
+// key in its own, so a change reaches exactly the stages downstream of it.
+
+class StageCounters
+{
+public:
+    StageCounters(const char *name) : _name(name) {}
+
+    const char *getName() const
+    {
+        return _name;
+    }
+
+    uint64_t getHits() const
+    {
+        return _hits;
+    }
+
+    uint64_t getMisses() const
+    {
+        return _misses;
+    }
+
+    // "name: hits hits, misses misses"
+    std::string toString() const
+    {
+        return std::string(_name) + ": " + std::to_string(_hits) + " hits, " + std::to_string(_misses) + " misses";
+    }
+
+protected:
+    const char *_name;
+    uint64_t _hits = 0, _misses = 0;
+};
+
+// stage whose output is kept by its owner (a mapper, the splines of the Model)
+template <typename Key>
+class Stage : public StageCounters
+{
+public:
+    Stage(const char *name) : StageCounters(name) {}
+
+    // true if the output has to be recomputed for key, the key counts as computed from then on
+    bool update(const Key &key)
+    {
+        if (_valid && _key == key)
+        {
+            _hits++;
+            return false;
+        }
+        _key = key;
+        _valid = true;
+        _misses++;
+        return true;
+    }
+
+    void invalidate()
+    {
+        _valid = false;
+    }
+
+private:
+    bool _valid = false;
+    Key _key;
+};
+
+// stage that keeps its outputs for the last Slots different keys (callers alternate between sizes)
+template <typename Key, typename Value, int Slots = 1>
+class StageCache : public StageCounters
+{
+public:
+    StageCache(const char *name) : StageCounters(name) {}
+
+    // output for key, compute(value) fills the oldest slot if no slot holds key
+    template <typename Compute>
+    const Value &get(const Key &key, Compute compute)
+    {
+        for (Entry &entry : _entries)
+        {
+            if (entry.valid && entry.key == key)
+            {
+                _hits++;
+                return entry.value;
+            }
+        }
+
+        Entry &entry = _entries[_next];
+        _next = (_next + 1) % Slots;
+        entry.valid = false;
+        compute(entry.value);
+        entry.key = key;
+        entry.valid = true;
+        _misses++;
+        return entry.value;
+    }
+
+    void invalidate()
+    {
+        for (Entry &entry : _entries)
+        {
+            entry.valid = false;
+        }
+    }
+
+private:
+    struct Entry
+    {
+        bool valid = false;
+        Key key;
+        Value value;
+    };
+
+    Entry _entries[Slots];
+    int _next = 0;
+};
\ No newline at end of file
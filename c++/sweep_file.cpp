@@ -0,0 +1,266 @@
+#include "sweep_file.hpp"
+
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "util.hpp"
+
+//********************************/
+// Sweep result file
+
+SweepFileHeader createSweepFileHeader(uint32_t chunk_points, uint64_t total_points)
+{
+    SweepFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SWEEP_FILE_MAGIC, sizeof(header.magic));
+    header.version = SWEEP_FILE_VERSION;
+    header.chunk_points = chunk_points;
+    header.total_points = total_points;
+    return header;
+}
+
+size_t getChunkSize(uint32_t chunk_points)
+{
+    return sizeof(SweepChunkHeader) + size_t(SWEEP_COLUMNS) * chunk_points * sizeof(float);
+}
+
+// covers magic, index and points too, so a damaged chunk header is not taken as valid
+static uint32_t getChunkCRC(const SweepChunkHeader &chunk, const unsigned char *columns, size_t length)
+{
+    uint32_t crc = crc32(reinterpret_cast<const unsigned char *>(&chunk), offsetof(SweepChunkHeader, crc));
+    return crc32(columns, length, crc);
+}
+
+void scanSweepChunks(const unsigned char *data, size_t size, bool verify_crc, int &chunks, uint64_t &points)
+{
+    chunks = 0;
+    points = 0;
+    const SweepFileHeader *header = reinterpret_cast<const SweepFileHeader *>(data);
+    size_t chunk_size = getChunkSize(header->chunk_points);
+
+    for (size_t offset = sizeof(SweepFileHeader); offset + chunk_size <= size; offset += chunk_size)
+    {
+        SweepChunkHeader chunk;
+        std::memcpy(&chunk, data + offset, sizeof(chunk));
+        if (chunk.magic != SWEEP_CHUNK_MAGIC || chunk.index != uint32_t(chunks) || chunk.points == 0 || chunk.points > header->chunk_points)
+            break;
+        // only the last chunk of a complete sweep may be partially filled
+        if (chunk.points < header->chunk_points && points + chunk.points != header->total_points)
+            break;
+        if (verify_crc && getChunkCRC(chunk, data + offset + sizeof(chunk), chunk_size - sizeof(chunk)) != chunk.crc)
+            break;
+        chunks++;
+        points += chunk.points;
+    }
+}
+
+//********************************/
+// SweepFileWriter implementation
+
+SweepFileWriter::~SweepFileWriter()
+{
+    close();
+}
+
+long long SweepFileWriter::open(const std::string &path, const SweepFileHeader &header)
+{
+    close();
+    _header = header;
+    _chunk_index = 0;
+    _chunk_fill = 0;
+    _columns.assign(size_t(SWEEP_COLUMNS) * header.chunk_points, 0.f);
+
+    uint64_t resumed_points = 0;
+    if (std::filesystem::exists(path) && std::filesystem::file_size(path) > 0)
+    {
+        int chunks = 0;
+        {
+            SweepFileReader reader;
+            if (!reader.open(path))
+            {
+                std::cerr << "Sweep file " << path << " exists but can not be read.\n";
+                return -1;
+            }
+            if (std::memcmp(&reader.getHeader(), &header, sizeof(header)) != 0)
+            {
+                std::cerr << "Sweep file " << path << " belongs to a different sweep.\n";
+                return -1;
+            }
+            chunks = reader.getChunkCount();
+            resumed_points = reader.getPointCount();
+        }
+
+        // drop everything after the last complete chunk
+        std::filesystem::resize_file(path, sizeof(SweepFileHeader) + chunks * getChunkSize(header.chunk_points));
+        _file = fopen(path.c_str(), "r+b");
+        if (_file == nullptr)
+        {
+            std::cerr << "Failed to open sweep file " << path << "\n";
+            return -1;
+        }
+        fseek(_file, 0, SEEK_END);
+        _chunk_index = chunks;
+    }
+    else
+    {
+        _file = fopen(path.c_str(), "wb");
+        if (_file == nullptr)
+        {
+            std::cerr << "Failed to create sweep file " << path << "\n";
+            return -1;
+        }
+        fwrite(&header, sizeof(header), 1, _file);
+        fflush(_file);
+    }
+    return (long long)resumed_points;
+}
+
+void SweepFileWriter::write(const float values[SWEEP_COLUMNS])
+{
+    for (int c = 0; c < SWEEP_COLUMNS; c++)
+    {
+        _columns[size_t(c) * _header.chunk_points + _chunk_fill] = values[c];
+    }
+    _chunk_fill++;
+    if (_chunk_fill == _header.chunk_points)
+    {
+        writeChunk();
+    }
+}
+
+void SweepFileWriter::close()
+{
+    if (_file == nullptr)
+        return;
+    if (_chunk_fill > 0)
+    {
+        writeChunk();
+    }
+    fclose(_file);
+    _file = nullptr;
+}
+
+// a chunk is flushed as a whole, a killed sweep loses at most the chunk being filled
+void SweepFileWriter::writeChunk()
+{
+    // partial chunk: zero the unused entries of every column
+    for (int c = 0; c < SWEEP_COLUMNS; c++)
+    {
+        std::fill(_columns.begin() + size_t(c) * _header.chunk_points + _chunk_fill, _columns.begin() + size_t(c + 1) * _header.chunk_points, 0.f);
+    }
+
+    SweepChunkHeader chunk;
+    chunk.magic = SWEEP_CHUNK_MAGIC;
+    chunk.index = _chunk_index;
+    chunk.points = _chunk_fill;
+    chunk.crc = getChunkCRC(chunk, reinterpret_cast<const unsigned char *>(_columns.data()), _columns.size() * sizeof(float));
+
+    fwrite(&chunk, sizeof(chunk), 1, _file);
+    fwrite(_columns.data(), sizeof(float), _columns.size(), _file);
+    fflush(_file);
+
+    _chunk_index++;
+    _chunk_fill = 0;
+}
+
+//********************************/
+// SweepFileReader implementation
+
+SweepFileReader::~SweepFileReader()
+{
+    close();
+}
+
+bool SweepFileReader::open(const std::string &path, bool verify_crc)
+{
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    GetFileSizeEx(file, &size);
+    HANDLE mapping = size.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    const void *data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (data == nullptr)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    _file_handle = file;
+    _mapping_handle = mapping;
+    _data = static_cast<const unsigned char *>(data);
+    _size = size_t(size.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        ::close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping stays valid
+    if (data == MAP_FAILED)
+        return false;
+    _data = static_cast<const unsigned char *>(data);
+    _size = size_t(st.st_size);
+#endif
+
+    if (_size < sizeof(SweepFileHeader) || std::memcmp(getHeader().magic, SWEEP_FILE_MAGIC, sizeof(getHeader().magic)) != 0 ||
+        getHeader().version != SWEEP_FILE_VERSION || getHeader().chunk_points == 0)
+    {
+        std::cerr << "Not a sweep file: " << path << "\n";
+        close();
+        return false;
+    }
+
+    scanSweepChunks(_data, _size, verify_crc, _chunks, _points);
+    return true;
+}
+
+void SweepFileReader::close()
+{
+    if (_data == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(_data);
+    CloseHandle((HANDLE)_mapping_handle);
+    CloseHandle((HANDLE)_file_handle);
+#else
+    munmap(const_cast<unsigned char *>(_data), _size);
+#endif
+    _data = nullptr;
+    _size = 0;
+    _chunks = 0;
+    _points = 0;
+}
+
+int SweepFileReader::getChunkPoints(int chunk) const
+{
+    SweepChunkHeader header;
+    std::memcpy(&header, getChunk(chunk), sizeof(header));
+    return int(header.points);
+}
+
+const float *SweepFileReader::getColumn(int chunk, SweepColumn column) const
+{
+    return reinterpret_cast<const float *>(getChunk(chunk) + sizeof(SweepChunkHeader)) + size_t(column) * getHeader().chunk_points;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//********************************/
+// Sweep result file
+//
+// Columnar binary output of the interpolate tool. A fixed header with the sweep parameters is
+// followed by chunks of a fixed size, so chunk i always starts at
+// sizeof(SweepFileHeader) + i * getChunkSize(). Every chunk holds one float column per value
+// (SweepColumn), each chunk_points long, and a CRC-32 of its chunk header and columns. The last chunk of a
+// finished sweep may be partially filled, the unused entries are zero.
+// All values are stored in the byte order of the writing machine (little endian on x86/ARM).
+
+#define SWEEP_FILE_MAGIC "ANRSWEEP"
+#define SWEEP_FILE_VERSION 2
+#define SWEEP_CHUNK_MAGIC 0x4b4e4843 // "CHNK"
+
+enum SweepColumn
+{
+    SWEEP_COLUMN_IF,
+    SWEEP_COLUMN_D,
+    SWEEP_COLUMN_R,
+    SWEEP_COLUMN_EH, // summed x error
+    SWEEP_COLUMN_EV, // summed y error
+    SWEEP_COLUMN_ER, // summed relative x/y error
+    SWEEP_COLUMN_EA, // summed angle error
+    SWEEP_COLUMNS
+};
+
+struct SweepFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t chunk_points;
+    uint64_t total_points; // points of the complete sweep
+
+    // sweep parameters, a file is only resumed by a sweep with the same values
+    float if_low, if_high;
+    int32_t if_steps;
+    float d_low, d_high;
+    int32_t d_steps;
+    float r_low, r_high;
+    int32_t r_steps;
+    int32_t enforce_isotropy;
+    float smoothing;
+    float dist_quality;
+    float scale;
+
+    // input identity: CRC-32 and size of the decoded mask and unrolling image
+    uint32_t mask_crc;
+    int32_t mask_width, mask_height;
+    uint32_t image_crc;
+    int32_t image_width, image_height;
+
+    uint32_t reserved[7];
+};
+
+static_assert(sizeof(SweepFileHeader) == 128, "SweepFileHeader has to keep its layout");
+
+struct SweepChunkHeader
+{
+    uint32_t magic;
+    uint32_t index;
+    uint32_t points;
+    uint32_t crc; // CRC-32 of the fields above and the columns
+};
+
+// header with magic and version set, everything else zero
+SweepFileHeader createSweepFileHeader(uint32_t chunk_points, uint64_t total_points);
+
+// size in bytes of one chunk including its SweepChunkHeader
+size_t getChunkSize(uint32_t chunk_points);
+
+class SweepFileWriter
+{
+public:
+    SweepFileWriter() = default;
+    SweepFileWriter(const SweepFileWriter &) = delete;
+    SweepFileWriter &operator=(const SweepFileWriter &) = delete;
+
+    ~SweepFileWriter();
+
+    // creates the file, or resumes an existing file of the same sweep after its last complete chunk
+    // returns the number of points already stored (to be skipped by the sweep), -1 on error
+    long long open(const std::string &path, const SweepFileHeader &header);
+
+    // appends one point, full chunks are written immediately
+    void write(const float values[SWEEP_COLUMNS]);
+
+    // writes the partially filled last chunk
+    void close();
+
+private:
+    void writeChunk();
+
+    FILE *_file = nullptr;
+    SweepFileHeader _header;
+    uint32_t _chunk_index = 0;
+    uint32_t _chunk_fill = 0;
+    std::vector<float> _columns; // SWEEP_COLUMNS * chunk_points
+};
+
+// memory mapped read access, the columns point directly into the mapping
+class SweepFileReader
+{
+public:
+    SweepFileReader() = default;
+    SweepFileReader(const SweepFileReader &) = delete;
+    SweepFileReader &operator=(const SweepFileReader &) = delete;
+
+    ~SweepFileReader();
+
+    // maps the file and checks the chunks up to the first invalid one (verify_crc also checks the checksums)
+    bool open(const std::string &path, bool verify_crc = true);
+    void close();
+
+    const SweepFileHeader &getHeader() const
+    {
+        return *reinterpret_cast<const SweepFileHeader *>(_data);
+    }
+
+    // number of complete, valid chunks
+    int getChunkCount() const
+    {
+        return _chunks;
+    }
+
+    uint64_t getPointCount() const
+    {
+        return _points;
+    }
+
+    int getChunkPoints(int chunk) const;
+    const float *getColumn(int chunk, SweepColumn column) const;
+
+private:
+    const unsigned char *getChunk(int chunk) const
+    {
+        return _data + sizeof(SweepFileHeader) + chunk * getChunkSize(getHeader().chunk_points);
+    }
+
+    const unsigned char *_data = nullptr;
+    size_t _size = 0;
+    int _chunks = 0;
+    uint64_t _points = 0;
+#ifdef _WIN32
+    void *_file_handle = nullptr;
+    void *_mapping_handle = nullptr;
+#endif
+};
+
+// number of complete, valid chunks and their points in data (a whole file in memory or mapped)
+void scanSweepChunks(const unsigned char *data, size_t size, bool verify_crc, int &chunks, uint64_t &points);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdio>
+
+//********************************/
+// Checks of the tests
+//
+// Every test is a small program that returns the number of failed checks (0 = passed), so it
+// runs under ctest without a test framework.
+
+static int check_failures = 0;
+
+// prints the failed condition with its location and counts it
+#define CHECK(condition)                                                                  \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(condition))                                                                 \
+        {                                                                                 \
+            std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);    \
+            check_failures++;                                                             \
+        }                                                                                 \
+    } while (0)
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "check.hpp"
+#include "../cubic_spline.hpp"
+
+// CubicSpline against alglib::spline1dcalc, spline1ddiff and spline1dintegrate
+
+#define MAX_DEVIATION 1e-9       // double evaluations, relative to the value range
+#define MAX_DEVIATION_FLOAT 1e-5 // CubicSpline::evaluate (float in and out)
+
+// query positions: every knot, points inside every interval (the first and the last included)
+// and half an interval beyond both ends (extrapolation)
+static std::vector<double> getQueries(const alglib::spline1dinterpolant &spline)
+{
+    alglib::ae_int_t n;
+    alglib::real_2d_array table;
+    alglib::spline1dunpack(spline, n, table);
+
+    std::vector<double> queries;
+    double first_width = table[0][1] - table[0][0];
+    queries.push_back(table[0][0] - first_width / 2);
+    for (int i = 0; i < int(n) - 1; i++)
+    {
+        double left = table[i][0], right = table[i][1];
+        for (double f : {0.0, 0.01, 0.25, 0.5, 0.75, 0.99})
+        {
+            queries.push_back(left + f * (right - left));
+        }
+    }
+    double last_left = table[n - 2][0], last_right = table[n - 2][1];
+    queries.push_back(last_right);
+    queries.push_back(last_right + (last_right - last_left) / 2);
+    return queries;
+}
+
+static void checkSpline(const char *name, const alglib::spline1dinterpolant &spline)
+{
+    CubicSpline cubic;
+    cubic.set(spline);
+    std::vector<double> queries = getQueries(spline);
+
+    double range = 0;
+    for (double x : queries)
+    {
+        range = std::max(range, std::abs(alglib::spline1dcalc(spline, x)));
+    }
+    range = std::max(range, 1.0);
+
+    double max_value = 0, max_derivative = 0, max_integral = 0;
+    for (double x : queries)
+    {
+        double value, derivative, second;
+        alglib::spline1ddiff(spline, x, value, derivative, second);
+
+        max_value = std::max(max_value, std::abs(cubic(x) - alglib::spline1dcalc(spline, x)));
+
+        double cubic_value, cubic_derivative;
+        cubic.diff(x, cubic_value, cubic_derivative);
+        max_value = std::max(max_value, std::abs(cubic_value - value));
+        max_derivative = std::max(max_derivative, std::abs(cubic_derivative - derivative));
+
+        max_integral = std::max(max_integral, std::abs(cubic.integrate(x) - alglib::spline1dintegrate(spline, x)));
+    }
+
+    // batched evaluation, ascending (cursor) and descending (search) queries
+    std::vector<float> x(queries.begin(), queries.end());
+    std::vector<float> x_descending(x.rbegin(), x.rend());
+    double max_batch = 0;
+    for (const std::vector<float> &batch_x : {x, x_descending})
+    {
+        std::vector<float> out(batch_x.size()), derivative(batch_x.size());
+        cubic.evaluate(batch_x.data(), int(batch_x.size()), out.data(), derivative.data());
+        for (size_t k = 0; k < batch_x.size(); k++)
+        {
+            double value, d, second;
+            alglib::spline1ddiff(spline, batch_x[k], value, d, second);
+            max_batch = std::max({max_batch, std::abs(out[k] - value), std::abs(derivative[k] - d)});
+        }
+    }
+
+    std::printf("%s: %d queries, max difference value %g, derivative %g, integral %g, batch %g\n", name, int(queries.size()),
+                max_value, max_derivative, max_integral, max_batch);
+    CHECK(max_value <= MAX_DEVIATION * range);
+    CHECK(max_derivative <= MAX_DEVIATION * range);
+    CHECK(max_integral <= MAX_DEVIATION * range);
+    CHECK(max_batch <= MAX_DEVIATION_FLOAT * range);
+}
+
+int main()
+{
+    // a contour like the ones of the masks: z-height -> arc length (monotone) and arc length -> radius (fit)
+    int samples = 300;
+    std::vector<double> z(samples), arc_length(samples), radius(samples);
+    for (int i = 0; i < samples; i++)
+    {
+        z[i] = 10.0 * i / (samples - 1);
+        radius[i] = 2 + 0.5 * std::sin(z[i] * 0.5) + 0.1 * z[i];
+    }
+    arc_length[0] = 0;
+    for (int i = 1; i < samples; i++)
+    {
+        arc_length[i] = arc_length[i - 1] + std::hypot(z[i] - z[i - 1], radius[i] - radius[i - 1]);
+    }
+
+    alglib::real_1d_array z_array, arc_length_array, radius_array;
+    z_array.setcontent(samples, z.data());
+    arc_length_array.setcontent(samples, arc_length.data());
+    radius_array.setcontent(samples, radius.data());
+
+    alglib::spline1dinterpolant monotone;
+    alglib::spline1dbuildmonotone(z_array, arc_length_array, monotone);
+    checkSpline("monotone", monotone);
+
+    alglib::spline1dinterpolant fit;
+    alglib::spline1dfitreport report;
+    alglib::spline1dfit(arc_length_array, radius_array, samples / 2, 0.000001, fit, report);
+    checkSpline("fit", fit);
+
+    // unevenly spaced knots
+    alglib::real_1d_array x, y;
+    double x_values[] = {-3.0, -2.9, -1.0, 0.5, 0.6, 4.0};
+    double y_values[] = {1.0, -2.0, 0.5, 3.0, 2.5, -1.0};
+    x.setcontent(6, x_values);
+    y.setcontent(6, y_values);
+    alglib::spline1dinterpolant cubic;
+    alglib::spline1dbuildcubic(x, y, cubic);
+    checkSpline("uneven cubic", cubic);
+
+    // a single interval is the first and the last one at once
+    alglib::real_1d_array x2, y2;
+    double x2_values[] = {1.0, 2.0};
+    double y2_values[] = {3.0, -1.0};
+    x2.setcontent(2, x2_values);
+    y2.setcontent(2, y2_values);
+    alglib::spline1dinterpolant single;
+    alglib::spline1dbuildcubic(x2, y2, single);
+    checkSpline("single interval", single);
+
+    return check_failures;
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include <cmath>
+#include <cstdio>
+
+#include "check.hpp"
+#include "../cpu_error_mapper.hpp"
+
+// vectorized error kernel (cpu_error_kernel.hpp) against the scalar double path of ErrorMapper
+
+#define ARC_LENGTH 10.f
+
+// jitter tables as Model::setupErrorMappingTables builds them, for a synthetic contour and IF curve
+static void setupTables(int width, int height, float interpolation_factor, float d, float crop_left, float crop_right, MappingTables &tables)
+{
+    float a = 3 * (interpolation_factor - d); // QuadraticFunction::update
+    auto integral = [&](float x)
+    { return a * x * x * x / 3 + d * x; };
+
+    for (int w = 0; w < width; w++)
+    {
+        float x_center = (mix(crop_left, 1 - crop_right, float(w) / (width - 1)) - 0.5f) * 2;
+        float x_jittered = x_center + (x_center < 0 ? JITTER : -JITTER);
+        tables._if_curve_integrals[w * 2] = integral(std::abs(x_center));
+        tables._if_curve_integrals[w * 2 + 1] = integral(std::abs(x_jittered));
+    }
+    for (int h = 0; h < height; h++)
+    {
+        float h_a_center = ARC_LENGTH * h / (height - 1);
+        float h_a_bottom = h_a_center + JITTER * ARC_LENGTH;
+        for (int j = 0; j < 2; j++)
+        {
+            float h_a = j == 0 ? h_a_center : h_a_bottom;
+            tables._x_a_x[h * 2 + j] = h_a;
+            tables._a_x_y[h * 2 + j] = 2 + 0.5f * std::sin(h_a * 0.5f);
+            tables._linear_fit[h * 2 + j] = 2.2f + 0.05f * h_a;
+        }
+    }
+}
+
+int main()
+{
+    if (!errorKernelVectorAvailable())
+    {
+        std::printf("vectorized error kernel not available, skipped\n");
+        return 0;
+    }
+
+    // widths with a tail that is not a multiple of 8
+    const int sizes[][2] = {{8, 5}, {37, 23}, {100, 61}, {203, 97}, {500, 500}, {1001, 333}};
+    const float tilts[] = {0.f, 0.3f, -0.7f, 1.2f, -1.5f};
+    for (const auto &size : sizes)
+    {
+        for (float tilt : tilts)
+        {
+            int width = size[0], height = size[1];
+            float crop_left = width % 2 ? 0.f : 0.05f; // odd widths without crop have a column at x = 0
+            float crop_right = width % 2 ? 0.f : 0.1f;
+            MappingTables tables(width * 2, height * 2);
+            setupTables(width, height, 0.6f, 0.4f, crop_left, crop_right, tables);
+
+            ErrorMapper reference, vectorized;
+            reference.setVectorized(false);
+            vectorized.setVectorized(true);
+            reference.map(width, height, &tables, ARC_LENGTH, 0.6f, 4.f, tilt, crop_left, crop_right);
+            vectorized.map(width, height, &tables, ARC_LENGTH, 0.6f, 4.f, tilt, crop_left, crop_right);
+
+            const CPUErrorMapResult &r = *reference._result, &v = *vectorized._result;
+            double max_error = 0, max_point = 0;
+            for (int i = 0; i < width * height; i++)
+            {
+                max_error = std::max({max_error, std::abs(r._e_x[i] - v._e_x[i]), std::abs(r._e_y[i] - v._e_y[i]),
+                                      std::abs(r._e_r[i] - v._e_r[i]), std::abs(r._e_a[i] - v._e_a[i])});
+                max_point = std::max({max_point, double(std::abs(r._x[i] - v._x[i])), double(std::abs(r._y[i] - v._y[i]))});
+            }
+            std::printf("%dx%d tilt %g: max squared error difference %g, max point difference %g\n", width, height, tilt, max_error, max_point);
+            CHECK(max_error <= ERROR_KERNEL_MAX_DEVIATION);
+            CHECK(max_point <= 1e-4);
+        }
+    }
+    return check_failures;
+}
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include "check.hpp"
+#include "../png_writer.hpp"
+#include "../util.hpp"
+
+#include <stb_image.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+// PNGStreamWriter output inflated again (stb_image zlib decoder) and compared with the input
+
+#define BTYPE_STORED 0
+#define BTYPE_FIXED 1
+#define BTYPE_ANY -1
+
+static uint32_t readBigEndian(const unsigned char *data)
+{
+    return uint32_t(data[0]) << 24 | uint32_t(data[1]) << 16 | uint32_t(data[2]) << 8 | uint32_t(data[3]);
+}
+
+static uint32_t adler32(const unsigned char *data, size_t length)
+{
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+// writes the image in calls of rows_per_call rows, inflates the IDAT stream and decodes the file
+static void checkRoundTrip(const char *name, const std::vector<unsigned char> &image, int width, int height, int rows_per_call, int btype)
+{
+    std::printf("%s: %d x %d, %d rows per call\n", name, width, height, rows_per_call);
+    std::string path = (std::filesystem::temp_directory_path() / "test_png_writer.png").string();
+
+    PNGStreamWriter writer;
+    CHECK(writer.open(path, width, height));
+    for (int row = 0; row < height; row += rows_per_call)
+    {
+        CHECK(writer.writeRows(&image[size_t(row) * width * 4], rows_per_call));
+    }
+    CHECK(writer.close());
+
+    std::ifstream file(path, std::ios::binary);
+    std::vector<unsigned char> png((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::filesystem::remove(path);
+    const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    CHECK(png.size() > 8 && std::memcmp(png.data(), signature, 8) == 0);
+
+    // chunks with their checksums, the IDAT chunks form one zlib stream
+    std::vector<unsigned char> idat;
+    int idat_chunks = 0;
+    bool iend = false;
+    for (size_t offset = 8; offset + 12 <= png.size() && !iend;)
+    {
+        uint32_t length = readBigEndian(&png[offset]);
+        CHECK(offset + 12 + length <= png.size());
+        if (offset + 12 + length > png.size())
+            break;
+        const unsigned char *type = &png[offset + 4];
+        const unsigned char *data = &png[offset + 8];
+        CHECK(crc32(data, length, crc32(type, 4)) == readBigEndian(data + length));
+        if (std::memcmp(type, "IHDR", 4) == 0)
+        {
+            CHECK(readBigEndian(data) == uint32_t(width) && readBigEndian(data + 4) == uint32_t(height));
+        }
+        else if (std::memcmp(type, "IDAT", 4) == 0)
+        {
+            idat.insert(idat.end(), data, data + length);
+            idat_chunks++;
+        }
+        else if (std::memcmp(type, "IEND", 4) == 0)
+        {
+            iend = true;
+            CHECK(offset + 12 == png.size());
+        }
+        offset += 12 + length;
+    }
+    CHECK(iend);
+    CHECK(idat_chunks == (height + rows_per_call - 1) / rows_per_call);
+    CHECK(idat.size() > 6);
+    if (idat.size() <= 6)
+        return;
+    // stb picks the block type of the first piece
+    CHECK(btype == BTYPE_ANY || ((idat[2] >> 1) & 3) == btype);
+
+    // filter byte and RGBA per row, followed by the Adler-32 of the filtered rows
+    int inflated_length = 0;
+    char *inflated = stbi_zlib_decode_malloc(reinterpret_cast<const char *>(idat.data()), int(idat.size()), &inflated_length);
+    CHECK(inflated != nullptr);
+    if (inflated == nullptr)
+        return;
+    CHECK(size_t(inflated_length) == size_t(height) * (size_t(width) * 4 + 1));
+    CHECK(adler32(reinterpret_cast<unsigned char *>(inflated), inflated_length) == readBigEndian(&idat[idat.size() - 4]));
+    free(inflated);
+
+    int decoded_width, decoded_height, channels;
+    unsigned char *decoded = stbi_load_from_memory(png.data(), int(png.size()), &decoded_width, &decoded_height, &channels, 4);
+    CHECK(decoded != nullptr);
+    if (decoded == nullptr)
+        return;
+    CHECK(decoded_width == width && decoded_height == height);
+    CHECK(std::memcmp(decoded, image.data(), image.size()) == 0);
+    stbi_image_free(decoded);
+}
+
+int main()
+{
+    std::mt19937 random(1);
+
+    // compressible rows: stb writes a fixed Huffman block per piece
+    int width = 700, height = 400;
+    std::vector<unsigned char> gradient(size_t(width) * height * 4);
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            unsigned char *pixel = &gradient[(size_t(y) * width + x) * 4];
+            pixel[0] = (unsigned char)(x * 255 / width);
+            pixel[1] = (unsigned char)(y * 255 / height);
+            pixel[2] = (unsigned char)((x ^ y) & 0xff);
+            pixel[3] = (unsigned char)(random() % 4 == 0 ? 128 : 255);
+        }
+    }
+    // one call: more than 2 * PNG_DEFLATE_PIECE bytes, so several pieces in one IDAT chunk
+    checkRoundTrip("gradient", gradient, width, height, height, BTYPE_FIXED);
+    // many calls, the last one partial
+    checkRoundTrip("gradient", gradient, width, height, 37, BTYPE_FIXED);
+
+    // noise does not compress: stb falls back to stored blocks
+    std::vector<unsigned char> noise(size_t(width) * height * 4);
+    for (unsigned char &value : noise)
+    {
+        value = (unsigned char)random();
+    }
+    checkRoundTrip("noise", noise, width, height, height, BTYPE_STORED);
+    checkRoundTrip("noise", noise, width, height, 128, BTYPE_STORED);
+
+    // a single row, small and wide enough for several pieces
+    std::vector<unsigned char> row(7 * 4);
+    for (unsigned char &value : row)
+    {
+        value = (unsigned char)random();
+    }
+    checkRoundTrip("one row", row, 7, 1, 1, BTYPE_ANY);
+    std::vector<unsigned char> wide_row(size_t(200000) * 4);
+    for (size_t i = 0; i < wide_row.size(); i++)
+    {
+        wide_row[i] = (unsigned char)(i / 4 % 251);
+    }
+    checkRoundTrip("one wide row", wide_row, 200000, 1, 1, BTYPE_FIXED);
+
+    return check_failures;
+}
\ No newline at end of file
@@ -0,0 +1,148 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+//********************************/
+// ThreadPool implementation
+
+static thread_local bool tl_is_pool_worker = false;
+
+ThreadPool::ThreadPool(int num_threads)
+{
+    if (num_threads <= 0)
+    {
+        num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+    }
+
+    // the calling thread always participates, so one thread less is spawned
+    for (int i = 0; i < num_threads - 1; i++)
+    {
+        _workers.emplace_back([this]()
+                              { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (std::thread &worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::parallelFor(int begin, int end, int num_chunks, const std::function<void(int, int, int)> &fn)
+{
+    if (end <= begin)
+        return;
+
+    num_chunks = std::max(1, std::min(num_chunks, end - begin));
+
+    // run serially if there is nothing to distribute, if called from inside a job or if another thread owns the pool
+    std::unique_lock<std::mutex> job_lock(_job_mutex, std::defer_lock);
+    if (_workers.empty() || num_chunks == 1 || tl_is_pool_worker || !job_lock.try_lock())
+    {
+        int count = end - begin;
+        for (int c = 0; c < num_chunks; c++)
+        {
+            fn(c, begin + int((long long)count * c / num_chunks), begin + int((long long)count * (c + 1) / num_chunks));
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _fn = &fn;
+        _begin = begin;
+        _end = end;
+        _num_chunks = num_chunks;
+        _next_chunk = 0;
+        _done_chunks = 0;
+        _error = nullptr;
+        _generation++;
+    }
+    _wake.notify_all();
+
+    tl_is_pool_worker = true;
+    runChunks();
+    tl_is_pool_worker = false;
+
+    // wait until every chunk is done and no worker is still inside the job
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [this]()
+                   { return _done_chunks == _num_chunks && _active == 0; });
+    _fn = nullptr;
+
+    if (_error)
+    {
+        std::exception_ptr error = _error;
+        _error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    tl_is_pool_worker = true;
+    unsigned long long seen_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this, seen_generation]()
+                       { return _stop || (_generation != seen_generation && _fn != nullptr); });
+            if (_stop)
+                return;
+            seen_generation = _generation;
+            _active++;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _active--;
+        }
+        _finished.notify_all();
+    }
+}
+
+void ThreadPool::runChunks()
+{
+    long long count = _end - _begin;
+    while (true)
+    {
+        int c = _next_chunk++;
+        if (c >= _num_chunks)
+            break;
+
+        try
+        {
+            (*_fn)(c, _begin + int(count * c / _num_chunks), _begin + int(count * (c + 1) / _num_chunks));
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_error)
+            {
+                _error = std::current_exception();
+            }
+        }
+
+        if (++_done_chunks == _num_chunks)
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _finished.notify_all();
+        }
+    }
+}
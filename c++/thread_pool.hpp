@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//********************************/
+// ThreadPool implementation
+
+// Persistent pool of worker threads for data-parallel loops.
+// A range is always split into the same chunks regardless of how many workers pick them up,
+// so results written (or reduced) per chunk do not depend on scheduling.
+class ThreadPool
+{
+public:
+    ThreadPool(int num_threads = 0);
+
+    ~ThreadPool();
+
+    // process-wide pool sized to the hardware concurrency
+    static ThreadPool &shared();
+
+    // number of threads working on a job (workers + calling thread)
+    int size() const
+    {
+        return int(_workers.size()) + 1;
+    }
+
+    // calls fn(chunk, chunk_begin, chunk_end) for num_chunks contiguous sub-ranges of [begin, end)
+    // blocks until all chunks are done. nested calls and calls while the pool is busy run serially
+    // on the calling thread
+    void parallelFor(int begin, int end, int num_chunks, const std::function<void(int, int, int)> &fn);
+
+private:
+    void workerLoop();
+    void runChunks();
+
+    std::vector<std::thread> _workers;
+
+    std::mutex _job_mutex; // held by the thread that currently owns the workers
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _finished;
+    bool _stop = false;
+    unsigned long long _generation = 0;
+    int _active = 0;
+
+    // current job
+    const std::function<void(int, int, int)> *_fn = nullptr;
+    int _begin = 0, _end = 0, _num_chunks = 0;
+    std::atomic<int> _next_chunk{0};
+    std::atomic<int> _done_chunks{0};
+    std::exception_ptr _error;
+};
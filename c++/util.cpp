@@ -4,6 +4,8 @@
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <map>
+#include <mutex>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -314,6 +316,61 @@ Vec4 getErrorColor(double t)
     }
 }
 
+std::shared_ptr<const std::vector<unsigned int>> getGridTriangles(int width, int height)
+{
+    // the indices of a size are freed together with the last result using them
+    static std::mutex cache_mutex;
+    static std::map<std::pair<int, int>, std::weak_ptr<const std::vector<unsigned int>>> cache;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    std::weak_ptr<const std::vector<unsigned int>> &entry = cache[{width, height}];
+    if (std::shared_ptr<const std::vector<unsigned int>> cached = entry.lock())
+        return cached;
+
+    int cells_x = std::max(width - 1, 0), cells_y = std::max(height - 1, 0);
+    auto triangles = std::make_shared<std::vector<unsigned int>>(size_t(cells_x) * cells_y * 6);
+    unsigned int *t = triangles->data();
+    for (int yi = 0; yi < cells_y; yi++)
+    {
+        for (int xi = 1; xi <= cells_x; xi++, t += 6)
+        {
+            t[0] = yi * width + xi - 1;
+            t[1] = yi * width + xi;
+            t[2] = (yi + 1) * width + xi - 1;
+            t[3] = yi * width + xi;
+            t[4] = (yi + 1) * width + xi;
+            t[5] = (yi + 1) * width + xi - 1;
+        }
+    }
+    entry = triangles;
+    return triangles;
+}
+
+uint32_t crc32(const unsigned char *data, size_t length, uint32_t crc)
+{
+    static const std::vector<uint32_t> table = []()
+    {
+        std::vector<uint32_t> table(256);
+        for (uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++)
+            {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[n] = c;
+        }
+        return table;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++)
+    {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
 void debug(const char *message)
 {
     std::cout << message << "\n";
@@ -2,6 +2,9 @@
 #define UTIL_H
 
 #include <boost/json.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
 
 #define CHANNELS 4
 #define GRID_SUBDIVISIONS 100
@@ -14,12 +17,19 @@
 class MappingTables
 {
 public:
-    MappingTables(int width, int height)
+    MappingTables(int width, int height, bool derivatives = false)
     {
         _if_curve_integrals = new float[width];
         _x_a_x = new float[height];
         _a_x_y = new float[height];
         _linear_fit = new float[height];
+
+        if (derivatives)
+        {
+            _if_curve_values = new float[width];
+            _d_x_a_x = new float[height];
+            _d_a_x_y = new float[height];
+        }
     }
 
     ~MappingTables()
@@ -28,12 +38,21 @@ public:
         delete[] _x_a_x;
         delete[] _a_x_y;
         delete[] _linear_fit;
+        delete[] _if_curve_values;
+        delete[] _d_x_a_x;
+        delete[] _d_a_x_y;
     }
 
     float *_if_curve_integrals;
     float *_x_a_x;
     float *_a_x_y;
     float *_linear_fit;
+
+    // derivatives for the analytic error evaluation (only allocated on request)
+    float *_if_curve_values = nullptr; // IF curve at |x| (derivative of the integral)
+    float *_d_x_a_x = nullptr;         // d x_a_x / d h_a
+    float *_d_a_x_y = nullptr;         // d a_x_y / d h_a
+    float _d_linear_fit = 0;           // slope of the linear fit
 };
 
 typedef struct RenderData
@@ -41,9 +60,21 @@ typedef struct RenderData
     float *_x;
     float *_y;
     float *_c;
-    unsigned int *_t;
+    const unsigned int *_t;
 } __RenderData__;
 
+// triangle indices of a regular width x height grid, two triangles per cell in row major order.
+// the topology only depends on the size, so all mapping results of one size share these indices
+std::shared_ptr<const std::vector<unsigned int>> getGridTriangles(int width, int height);
+
+// texture coordinates of the grid vertex (xi, yi): (u[xi], v[yi]). u only depends on the column and
+// v on the row, so the renderers look them up by the vertex index instead of storing them per vertex
+struct GridTexCoords
+{
+    const float *u; // per column
+    const float *v; // per row
+};
+
 //********************************/
 // ChatGPT generated Vec4
 struct Vec4
@@ -116,6 +147,9 @@ T mix(const T &a, const T &b, double t)
 
 Vec4 getErrorColor(double t);
 
+// CRC-32 as used by zlib and PNG, crc continues a previous checksum
+uint32_t crc32(const unsigned char *data, size_t length, uint32_t crc = 0);
+
 void debug(const char *message);
 
 #endif // UTIL_H
\ No newline at end of file